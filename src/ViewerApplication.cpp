@@ -1,7 +1,11 @@
 #include "ViewerApplication.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <iostream>
 #include <numeric>
+#include <unordered_map>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -10,11 +14,31 @@
 
 #include "utils/cameras.hpp"
 #include "utils/gltf.hpp"
+#include "utils/gltf_loader.hpp"
+#include "utils/hash.hpp"
+#include "utils/mesh_optimizer.hpp"
 
 #include <stb_image_write.h>
 #include <tiny_gltf.h>
 
 
+// Bytes sent to the GPU per frame while a model is being uploaded, so that the
+// application stays responsive during the upload
+static const size_t UPLOAD_BYTE_COUNT_PER_FRAME = 64 * 1024 * 1024;
+
+// Size of the staging ring through which geometry is uploaded. Twice the
+// bytes uploaded per frame, so that a frame can fill half of it while the GPU
+// copies from the other half.
+static const size_t STAGING_RING_BYTE_COUNT = 2 * UPLOAD_BYTE_COUNT_PER_FRAME;
+
+// Growth of the geometry arena when it is recreated because a reloaded model
+// does not fit in it, so that next reloads likely fit
+static const double ARENA_GROWTH_FACTOR = 1.5;
+
+// Time without changes of the glTF files before reloading them, exporters
+// often write several files in a row
+static const double RELOAD_DELAY_SECONDS = 0.2;
+
 void keyCallback(
     GLFWwindow *window, int key, int scancode, int action, int mods)
 {
@@ -23,18 +47,110 @@ void keyCallback(
   }
 }
 
-bool ViewerApplication::loadGltfFile(tinygltf::Model& model) {
-  static tinygltf::TinyGLTF loader;
+// True if the program reads the vertex attribute at this location
+bool isVertexAttribActive(GLuint program, GLint location)
+{
+  GLint attribCount = 0;
+  glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attribCount);
+  for (GLint i = 0; i < attribCount; ++i) {
+    GLchar name[256];
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveAttrib(
+        program, GLuint(i), sizeof(name), nullptr, &size, &type, name);
+    if (glGetAttribLocation(program, name) == location) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Sizes of what was loaded, for the load report
+void addModelCounts(const tinygltf::Model &model, const GltfBuffers &buffers,
+    LoadReport &report)
+{
+  size_t bufferByteCount = 0;
+  for (const auto &bytes : buffers.bytes) {
+    bufferByteCount += bytes.size;
+  }
+  size_t mappedByteCount = 0;
+  for (const auto &file : buffers.mappedFiles) {
+    mappedByteCount += file.size();
+  }
+  size_t primitiveCount = 0;
+  for (const auto &mesh : model.meshes) {
+    primitiveCount += mesh.primitives.size();
+  }
+  size_t imageByteCount = 0;
+  for (const auto &image : model.images) {
+    imageByteCount += image.image.size();
+  }
+  report.setCount("buffers", model.buffers.size());
+  report.setCount("bufferBytes", bufferByteCount);
+  report.setCount("mappedFileBytes", mappedByteCount);
+  report.setCount("bufferViews", model.bufferViews.size());
+  report.setCount("accessors", model.accessors.size());
+  report.setCount("meshes", model.meshes.size());
+  report.setCount("primitives", primitiveCount);
+  report.setCount("nodes", model.nodes.size());
+  report.setCount("scenes", model.scenes.size());
+  report.setCount("images", model.images.size());
+  report.setCount("decodedImageBytes", imageByteCount);
+}
+
+void printBenchmarkResult(std::vector<double> frameSeconds)
+{
+  std::sort(begin(frameSeconds), end(frameSeconds));
+  std::cout << "drawScene GPU time over " << frameSeconds.size()
+            << " frames: min " << frameSeconds.front() * 1000.
+            << " ms, median " << frameSeconds[frameSeconds.size() / 2] * 1000.
+            << " ms\n";
+}
+
+bool ViewerApplication::loadGltfFile(tinygltf::Model &model,
+    GltfBuffers &buffers, GltfLoadProgress *progress, LoadReport *report)
+{
+  ScopedPhaseTimer timer(report, "loadGltfFile");
   std::string err;
   std::string warn;
 
-  bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, m_gltfFilePath.string());
+  // A scene cache keyed by the content of the files is used if available
+  uint64_t contentHash = 0;
+  fs::path cachePath;
+  if (!m_cacheDirectory.empty()) {
+    std::string cacheErr;
+    auto hasContentHash = false;
+    {
+      ScopedPhaseTimer hashTimer(report, "sceneCache.hash");
+      hasContentHash =
+          computeGltfContentHash(m_gltfFilePath, contentHash, cacheErr);
+    }
+    if (!hasContentHash) {
+      std::cout << "Warn: " << cacheErr << "\n";
+    } else {
+      // Import stages change what is cached, each combination of them has
+      // its own cache
+      const uint64_t importStages[] = {uint64_t(m_optimizeVertexCache),
+          uint64_t(m_optimizeOverdraw), uint64_t(m_optimizeVertexFetch),
+          uint64_t(m_buildMeshlets), uint64_t(m_buildLods)};
+      contentHash = hash64(importStages, sizeof(importStages), contentHash);
+      cachePath = getSceneCachePath(m_cacheDirectory, contentHash);
+      ScopedPhaseTimer loadTimer(report, "sceneCache.load");
+      if (loadSceneCache(cachePath, contentHash, model, buffers, cacheErr)) {
+        std::clog << "Loaded scene cache " << cachePath << "\n";
+        return true;
+      }
+    }
+  }
+
+  bool ret = loadGltfModel(
+      m_gltfFilePath, model, buffers, err, warn, progress, report);
 
   if (!warn.empty()) {
     std::cout << "Warn: " << warn << "\n"; 
   }
 
-  if (!warn.empty()) {
+  if (!err.empty()) {
     std::cout << "Err: " << err << "\n"; 
   }
 
@@ -42,96 +158,433 @@ bool ViewerApplication::loadGltfFile(tinygltf::Model& model) {
     std::cout << "Failed to parse glTF\n"; 
   }
 
+  if (ret) {
+    runImportStages(model, buffers, report);
+  }
+
+  if (ret && !cachePath.empty()) {
+    ScopedPhaseTimer writeTimer(report, "sceneCache.write");
+    std::string cacheErr;
+    if (writeSceneCache(cachePath, contentHash, model, buffers, cacheErr)) {
+      std::clog << "Wrote scene cache " << cachePath << "\n";
+    } else {
+      std::cout << "Warn: " << cacheErr << "\n";
+    }
+  }
+
   return ret;
 }
 
-std::vector<GLuint> ViewerApplication::createBufferObjects(const tinygltf::Model &model) {
-  std::vector<GLuint> bufferObjects(model.buffers.size(), 0);
+bool ViewerApplication::reloadGltfFile(
+    tinygltf::Model &model, GltfBuffers &buffers)
+{
+  // The scene cache is not used, writing it would make reloads of large
+  // scenes slow
+  std::string err;
+  std::string warn;
+  const auto ret = loadGltfModel(m_gltfFilePath, model, buffers, err, warn);
+  if (!warn.empty()) {
+    std::cout << "Warn: " << warn << "\n";
+  }
+  if (!err.empty()) {
+    std::cout << "Err: " << err << "\n";
+  }
+  if (!ret) {
+    std::cout << "Failed to reload glTF\n";
+  } else {
+    runImportStages(model, buffers);
+  }
+  return ret;
+}
 
-  glGenBuffers(model.buffers.size(), bufferObjects.data());
-  for (size_t i = 0; i < model.buffers.size(); ++i) {
-    glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[i]);
-    glBufferStorage(GL_ARRAY_BUFFER, model.buffers[i].data.size(), // Assume a Buffer has a data member variable of type std::vector
-        model.buffers[i].data.data(), 0);
+void ViewerApplication::runImportStages(
+    tinygltf::Model &model, GltfBuffers &buffers, LoadReport *report)
+{
+  // Overdraw is optimized on the order given by the vertex cache
+  // optimization, and meshlets are compact in that order
+  if (m_optimizeVertexCache || m_optimizeOverdraw || m_buildMeshlets) {
+    ScopedPhaseTimer timer(report, "optimizeTriangleOrder");
+    const auto statistics =
+        optimizeModelTriangleOrder(model, buffers, m_optimizeOverdraw);
+    const auto triangleCount = std::max<size_t>(1, statistics.triangleCount);
+    std::clog << "Optimized vertex cache of " << statistics.triangleCount
+              << " triangles, ACMR "
+              << double(statistics.missCountBefore) / triangleCount << " -> "
+              << double(statistics.missCountAfter) / triangleCount;
+    if (m_optimizeOverdraw) {
+      std::clog << ", overdraw in " << statistics.clusterCount << " clusters";
+    }
+    std::clog << "\n";
+    if (report) {
+      report->setCount("vertexCacheTriangles", statistics.triangleCount);
+      report->setCount("vertexCacheMissesBefore", statistics.missCountBefore);
+      report->setCount("vertexCacheMissesAfter", statistics.missCountAfter);
+      report->setCount("overdrawClusters", statistics.clusterCount);
+    }
+  }
+  // Vertices are renumbered in the final triangle order
+  if (m_optimizeVertexFetch) {
+    ScopedPhaseTimer timer(report, "optimizeVertexFetch");
+    const auto statistics = optimizeModelVertexFetch(model, buffers);
+    const auto usedByteCount = std::max<size_t>(1, statistics.usedByteCount);
+    std::clog << "Optimized vertex fetch of " << statistics.usedVertexCount
+              << " vertices ("
+              << statistics.vertexCount - statistics.usedVertexCount
+              << " unused removed, " << statistics.duplicatedAccessorCount
+              << " shared accessors duplicated), overfetch "
+              << double(statistics.fetchedByteCountBefore) / usedByteCount
+              << " -> "
+              << double(statistics.fetchedByteCountAfter) / usedByteCount
+              << "\n";
+    if (report) {
+      report->setCount("vertexFetchVertices", statistics.vertexCount);
+      report->setCount("vertexFetchUsedVertices", statistics.usedVertexCount);
+      report->setCount(
+          "vertexFetchBytesBefore", statistics.fetchedByteCountBefore);
+      report->setCount(
+          "vertexFetchBytesAfter", statistics.fetchedByteCountAfter);
+      report->setCount("vertexFetchDuplicatedAccessors",
+          statistics.duplicatedAccessorCount);
+    }
+  }
+  if (m_buildMeshlets) {
+    ScopedPhaseTimer timer(report, "buildMeshlets");
+    const auto statistics = buildModelMeshlets(model, buffers);
+    const auto meshletCount = std::max<size_t>(1, statistics.meshletCount);
+    std::clog << "Split " << statistics.triangleCount << " triangles into "
+              << statistics.meshletCount << " meshlets of "
+              << double(statistics.triangleCount) / meshletCount
+              << " triangles and "
+              << double(statistics.meshletVertexCount) / meshletCount
+              << " vertices on average\n";
+    if (report) {
+      report->setCount("meshlets", statistics.meshletCount);
+      report->setCount("meshletVertices", statistics.meshletVertexCount);
+    }
   }
-  glBindBuffer(GL_ARRAY_BUFFER, 0); // Cleanup the binding point after the loop only
+  // Levels of detail are reordered for the vertex cache as they are built,
+  // they share the vertices renumbered for the base level
+  if (m_buildLods) {
+    ScopedPhaseTimer timer(report, "buildLods");
+    const auto statistics = buildModelLods(model, buffers);
+    std::clog << "Built levels of detail of " << statistics.primitiveCount
+              << " primitives, triangles per level";
+    for (const auto triangleCount : statistics.levelTriangleCounts) {
+      std::clog << " " << triangleCount;
+    }
+    std::clog << "\n";
+    if (report) {
+      report->setCount("lodPrimitives", statistics.primitiveCount);
+      for (size_t i = 1; i <= MAX_LOD_COUNT; ++i) {
+        report->setCount("lod" + std::to_string(i) + "Triangles",
+            statistics.levelTriangleCounts[i]);
+      }
+    }
+  }
+}
 
-  return bufferObjects;
+FileWatcher ViewerApplication::watchGltfFiles()
+{
+  // Only the glTF file itself is watched if it cannot be parsed, changes to
+  // it may fix it
+  std::vector<std::string> files;
+  std::string err;
+  if (!listGltfFiles(m_gltfFilePath, files, err)) {
+    files.assign(1, m_gltfFilePath.string());
+  }
+  try {
+    return FileWatcher(files);
+  } catch (const std::runtime_error &e) {
+    std::cout << "Warn: " << e.what() << ", hot reload disabled\n";
+    return FileWatcher();
+  }
 }
 
-std::vector<GLuint> ViewerApplication::createVertexArrayObjects (
-  const tinygltf::Model& model,
-  const std::vector<GLuint>& bufferObjects,
-  std::vector<VaoRange>& meshIndexToVaoRange) {
-  
-  std::vector<GLuint> vertexArrayObjects;
-
-  meshIndexToVaoRange.resize(model.meshes.size());
-
-  const static GLuint VERTEX_ATTRIB_POSITION_IDX = 0;
-  const static GLuint VERTEX_ATTRIB_NORMAL_IDX = 1;
-  const static GLuint VERTEX_ATTRIB_TEXCOORD0_IDX = 2;
-
-  const static std::vector<std::string> LABELS = {"POSITION", "NORMAL", "TEXCOORD0"};
-
-  for (int labelIdx = 0 ; labelIdx < 3 ; labelIdx++) {
-    for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx) {
-      const auto& mesh     = model.meshes[meshIdx];
-      auto& range          = meshIndexToVaoRange[meshIdx];
-      
-      range.begin = static_cast<GLsizei>(vertexArrayObjects.size());
-      range.count = static_cast<GLsizei>(mesh.primitives.size());
-
-      vertexArrayObjects.resize(range.begin + range.count);
-
-      glGenVertexArrays(range.count, &vertexArrayObjects[range.begin]);
-
-      for (size_t primitiveIdx = 0; primitiveIdx < mesh.primitives.size() ; primitiveIdx++) {
-        const auto vao = vertexArrayObjects[range.begin + primitiveIdx];
-        const auto& primitive = mesh.primitives[primitiveIdx];
-        glBindVertexArray(vao);
- 
-        const auto iterator = primitive.attributes.find(LABELS[labelIdx]);
-        
-        if (iterator != end(primitive.attributes)) { // If "POSITION" has been found in the map
-          // (*iterator).first is the key "POSITION", (*iterator).second is the value, ie. the index of the accessor for this attribute
-          const auto accessorIdx = (*iterator).second;
-          const auto &accessor = model.accessors[accessorIdx]; // TODO get the correct tinygltf::Accessor from model.accessors
-          const auto &bufferView = model.bufferViews[accessor.bufferView]; // TODO get the correct tinygltf::BufferView from model.bufferViews. You need to use the accessor
-          const auto bufferIdx = bufferView.buffer; // TODO get the index of the buffer used by the bufferView (you need to use it)
-
-          // const auto bufferObject = model.buffers[bufferIdx]; // TODO get the correct buffer object from the buffer index
-
-          // TODO Enable the vertex attrib array corresponding to POSITION with glEnableVertexAttribArray (you need to use VERTEX_ATTRIB_POSITION_IDX which has to be defined at the top of the cpp file)
-          glEnableVertexAttribArray(labelIdx);
-
-          // TODO Bind the buffer object to GL_ARRAY_BUFFER
-          glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[bufferIdx]);
-
-          const auto byteOffset = accessor.byteOffset + bufferView.byteOffset; // TODO Compute the total byte offset using the accessor and the buffer view
-          // TODO Call glVertexAttribPointer with the correct arguments.
-          
-          glVertexAttribPointer(labelIdx, accessor.type, accessor.componentType, GL_FALSE, bufferView.byteStride, (const GLvoid*) byteOffset);
-          // Remember size is obtained with accessor.type, type is obtained with accessor.componentType.
-          // The stride is obtained in the bufferView, normalized is always GL_FALSE, and pointer is the byteOffset (don't forget the cast).
+GeometryLayout ViewerApplication::layoutGeometry(
+    const tinygltf::Model &model, const GltfBuffers &buffers)
+{
+  // Blocks are keyed by content, computed now since memory mapped files show
+  // later changes. Not when streaming, which must not read the whole buffers
+  // in memory.
+  std::vector<uint64_t> bufferViewHashes;
+  if (!m_maxHostByteCount) {
+    bufferViewHashes = computeBufferViewHashes(model, buffers);
+  }
+  auto layout = computeGeometryLayout(model, buffers, bufferViewHashes);
+  if (m_maxHostByteCount) {
+    // The layout read whole accessors, drop their pages: indices for their
+    // ranges, positions for their bounds, meshlets and levels of detail
+    const auto releaseAccessorPages = [&](int accessorIdx, size_t count) {
+      const auto bytes =
+          getAccessorBytes(model, buffers, accessorIdx, 0, count);
+      for (const auto &file : buffers.mappedFiles) {
+        file.releasePages(bytes.data, bytes.size);
+      }
+    };
+    for (const auto &block : layout.indexBlocks) {
+      releaseAccessorPages(block.indexAccessor, block.count);
+    }
+    for (const auto &block : layout.vertexBlocks) {
+      releaseAccessorPages(
+          block.attribAccessors[VERTEX_ATTRIB_POSITION], block.count);
+    }
+    for (const auto &mesh : model.meshes) {
+      for (const auto &primitive : mesh.primitives) {
+        for (const auto &attribute : primitive.attributes) {
+          if (!isVertexAttribute(attribute.first) &&
+              isAccessorReadable(model, buffers, attribute.second)) {
+            releaseAccessorPages(attribute.second,
+                model.accessors[attribute.second].count);
+          }
         }
+      }
+    }
+  }
+  return layout;
+}
+
+ViewerApplication::GeometryArena ViewerApplication::createGeometryArena(
+    size_t vertexCapacity, size_t indexCapacity)
+{
+  GeometryArena arena;
+  arena.vertexFormat = m_vertexFormat;
+  // Buffers come from the pool by size class, capacities grow to fill their
+  // class so that the arena can grow that much without being recreated
+  const auto vertexByteSize = getArenaVertexBufferSize(m_vertexFormat, 1);
+  vertexCapacity =
+      getBufferSizeClass(vertexCapacity * vertexByteSize) / vertexByteSize;
+  indexCapacity =
+      getBufferSizeClass(indexCapacity * ARENA_INDEX_UNIT_BYTE_SIZE) /
+      ARENA_INDEX_UNIT_BYTE_SIZE;
+  arena.vertexCapacity = vertexCapacity;
+  arena.vertexAllocator = RangeAllocator(vertexCapacity);
+  arena.indexAllocator = RangeAllocator(indexCapacity);
+
+  // Only allocate, requested blocks are copied later from the staging ring by
+  // uploadGeometry(), so the storage needs no CPU access
+  arena.vertexBuffer =
+      m_glObjectPool.acquireBuffer(vertexCapacity * vertexByteSize);
+  arena.indexBuffer =
+      m_glObjectPool.acquireBuffer(indexCapacity * ARENA_INDEX_UNIT_BYTE_SIZE);
+
+  return arena;
+}
 
-        if (primitive.indices >= 0) {
-          const auto accessorIdx = primitive.indices;
-          const auto &accessor = model.accessors[accessorIdx];
-          const auto &bufferView = model.bufferViews[accessor.bufferView];
-          const auto bufferIdx = bufferView.buffer;
-
-          assert(GL_ELEMENT_ARRAY_BUFFER == bufferView.target);
-          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
-              bufferObjects[bufferIdx]); // Binding the index buffer to
-                                        // GL_ELEMENT_ARRAY_BUFFER while the VAO
-                                        // is bound is enough to tell OpenGL we
-                                        // want to use that index buffer for that
-                                        // VAO
+void ViewerApplication::deleteGeometryArena(GeometryArena &arena)
+{
+  m_glObjectPool.releaseBuffer(std::move(arena.vertexBuffer),
+      getArenaVertexBufferSize(arena.vertexFormat, arena.vertexCapacity));
+  m_glObjectPool.releaseBuffer(std::move(arena.indexBuffer),
+      arena.indexAllocator.capacity() * ARENA_INDEX_UNIT_BYTE_SIZE);
+  arena = GeometryArena{};
+}
+
+void ViewerApplication::requestSceneGeometry(const tinygltf::Model &model,
+    int sceneIdx, GeometryLayout &layout, GeometryUploadState &uploadState)
+{
+  // Geometry that no mesh of the scene reads is neither uploaded nor, for
+  // memory mapped buffers, read from disk
+  const auto request = [&](ArenaBlock &block, int blockIdx,
+                           bool isIndexBlock) {
+    if (!block.isRequested && !block.isUploaded) {
+      block.isRequested = true;
+      uploadState.requests.emplace_back(
+          GeometryUploadState::Request{blockIdx, isIndexBlock});
+      uploadState.totalByteCount +=
+          getArenaBlockByteSize(m_vertexFormat, block);
+    }
+  };
+  for (const auto meshIdx : computeSceneMeshes(model, sceneIdx)) {
+    const auto firstPrimitiveIdx = layout.meshFirstPrimitives[meshIdx];
+    for (size_t i = 0; i < model.meshes[meshIdx].primitives.size(); ++i) {
+      const auto &primitive = layout.primitives[firstPrimitiveIdx + i];
+      if (primitive.vertexBlock >= 0) {
+        request(layout.vertexBlocks[primitive.vertexBlock],
+            primitive.vertexBlock, false);
+      }
+      if (primitive.indexBlock >= 0) {
+        request(layout.indexBlocks[primitive.indexBlock], primitive.indexBlock,
+            true);
+      }
+      for (const auto &lod : primitive.lods) {
+        request(layout.indexBlocks[lod.indexBlock], lod.indexBlock, true);
+      }
+    }
+  }
+}
+
+bool ViewerApplication::uploadGeometry(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const GeometryArena &arena,
+    StagingRing &stagingRing, size_t maxByteCount, GeometryLayout &layout,
+    GeometryUploadState &uploadState)
+{
+  auto &requestIdx = uploadState.requestIdx;
+  auto &streamIdx = uploadState.streamIdx;
+  auto &elementOffset = uploadState.elementOffset;
+  while (requestIdx < uploadState.requests.size() && maxByteCount > 0) {
+    const auto &request = uploadState.requests[requestIdx];
+    auto &block = request.isIndexBlock ? layout.indexBlocks[request.blockIdx]
+                                       : layout.vertexBlocks[request.blockIdx];
+    // Vertex blocks are uploaded an attribute after the other, or all at once
+    // when interleaved
+    const auto &vertexFormat = arena.vertexFormat;
+    const auto isSingleStream =
+        request.isIndexBlock || vertexFormat.isInterleaved;
+    const auto streamCount = isSingleStream ? 1 : VERTEX_ATTRIB_COUNT;
+    while (!isSingleStream && streamIdx < streamCount &&
+           block.attribAccessors[streamIdx] < 0) {
+      ++streamIdx;
+    }
+    if (streamIdx == streamCount) {
+      block.isUploaded = true;
+      ++requestIdx;
+      streamIdx = 0;
+      continue;
+    }
+
+    auto elementByteSize = block.indexByteSize;
+    auto bufferObject = arena.indexBuffer.glId();
+    auto byteOffset = block.first * ARENA_INDEX_UNIT_BYTE_SIZE;
+    if (!request.isIndexBlock) {
+      elementByteSize = getVertexAttribStride(vertexFormat, streamIdx);
+      bufferObject = arena.vertexBuffer.glId();
+      byteOffset =
+          getVertexAttribOffset(vertexFormat, streamIdx, arena.vertexCapacity) +
+          block.first * elementByteSize;
+    }
+    // Accessors read by the stream
+    const auto readsAccessor = [&](int attrib) {
+      return !request.isIndexBlock &&
+             (vertexFormat.isInterleaved || attrib == streamIdx) &&
+             block.attribAccessors[attrib] >= 0;
+    };
+
+    // Elements are converted straight into the staging ring, then copied by
+    // the GPU to the arena
+    const auto maxChunkByteCount =
+        std::min(maxByteCount, stagingRing.capacity());
+    const auto elementCount = std::min(block.count - elementOffset,
+        std::max<size_t>(1, maxChunkByteCount / elementByteSize));
+    const auto byteCount = elementCount * elementByteSize;
+    byteOffset += elementOffset * elementByteSize;
+    if (byteCount > 0) {
+      size_t stagingOffset = 0;
+      auto *dst = stagingRing.allocate(byteCount, stagingOffset);
+      if (!dst) {
+        break; // The GPU still reads the ring, continue next frame
+      }
+      if (request.isIndexBlock) {
+        convertIndices(
+            model, buffers, block, elementOffset, elementCount, dst);
+      } else {
+        if (vertexFormat.isInterleaved &&
+            getVertexAttribMask(block) != (1u << VERTEX_ATTRIB_COUNT) - 1) {
+          std::fill(dst, dst + byteCount, 0); // Attributes the block lacks
+        }
+        for (int attrib = 0; attrib < VERTEX_ATTRIB_COUNT; ++attrib) {
+          if (readsAccessor(attrib)) {
+            const auto attribOffset =
+                vertexFormat.isInterleaved
+                    ? getVertexAttribOffset(vertexFormat, attrib, 0)
+                    : 0;
+            convertVertexAttrib(model, buffers, vertexFormat, block, attrib,
+                elementOffset, elementCount, dst + attribOffset,
+                elementByteSize);
+          }
+        }
+      }
+      stagingRing.copy(stagingOffset, bufferObject, byteOffset, byteCount);
+      if (m_maxHostByteCount) {
+        // Pages of the file were read by the conversion, drop them so that no
+        // more than a chunk of the file is resident at a time
+        const auto releasePages = [&](int accessorIdx) {
+          const auto bytes = getAccessorBytes(
+              model, buffers, accessorIdx, elementOffset, elementCount);
+          for (const auto &file : buffers.mappedFiles) {
+            file.releasePages(bytes.data, bytes.size);
+          }
+        };
+        if (request.isIndexBlock) {
+          releasePages(block.indexAccessor);
+        }
+        for (int attrib = 0; attrib < VERTEX_ATTRIB_COUNT; ++attrib) {
+          if (readsAccessor(attrib)) {
+            releasePages(block.attribAccessors[attrib]);
+          }
         }
       }
     }
+
+    elementOffset += elementCount;
+    maxByteCount -= std::min(maxByteCount, byteCount);
+    uploadState.uploadedByteCount += byteCount;
+    if (elementOffset == block.count) {
+      ++streamIdx;
+      elementOffset = 0;
+    }
+  }
+  stagingRing.fence();
+
+  return requestIdx == uploadState.requests.size();
+}
+
+std::vector<GLVertexArray> ViewerApplication::createVertexArrayObjects(
+    const GeometryLayout &layout, const GeometryArena &arena,
+    std::vector<int> &primitiveVaoIndices)
+{
+  // Attributes are read from the arena regions, the first vertex of each
+  // primitive is given by the base vertex of its draw calls. Primitives with
+  // the same attributes therefore share their VAO, whatever their mesh.
+  std::vector<GLVertexArray> vertexArrayObjects;
+  std::unordered_map<unsigned, int> attribMaskVaoIndices;
+  primitiveVaoIndices.assign(layout.primitives.size(), -1);
+  for (size_t i = 0; i < layout.primitives.size(); ++i) {
+    const auto &primitive = layout.primitives[i];
+    if (primitive.vertexBlock < 0) {
+      continue; // Not drawn
+    }
+    const auto attribMask =
+        getVertexAttribMask(layout.vertexBlocks[primitive.vertexBlock]);
+    const auto it = attribMaskVaoIndices.find(attribMask);
+    if (it != end(attribMaskVaoIndices)) {
+      primitiveVaoIndices[i] = it->second;
+      continue;
+    }
+
+    // VAOs from the pool keep their state, attributes the primitives do not
+    // read are disabled
+    auto vao = m_glObjectPool.acquireVertexArray();
+    glBindVertexArray(vao.glId());
+    // Formats are separate from buffer bindings, one binding per attribute
+    // region of the vertex buffer, or a single one for interleaved vertices
+    // whose attributes are at relative offsets
+    const auto &vertexFormat = arena.vertexFormat;
+    for (int attrib = 0; attrib < VERTEX_ATTRIB_COUNT; ++attrib) {
+      if (!(attribMask & (1u << attrib))) {
+        glDisableVertexAttribArray(attrib);
+      } else {
+        const auto offset =
+            getVertexAttribOffset(vertexFormat, attrib, arena.vertexCapacity);
+        const auto binding = vertexFormat.isInterleaved ? 0 : attrib;
+        const auto attribFormat = getVertexAttribFormat(vertexFormat, attrib);
+        glEnableVertexAttribArray(attrib);
+        glVertexAttribFormat(attrib, attribFormat.componentCount,
+            attribFormat.type, attribFormat.isNormalized,
+            GLuint(vertexFormat.isInterleaved ? offset : 0));
+        glVertexAttribBinding(attrib, binding);
+        glBindVertexBuffer(binding, arena.vertexBuffer.glId(),
+            GLintptr(vertexFormat.isInterleaved ? 0 : offset),
+            GLsizei(getVertexAttribStride(vertexFormat, attrib)));
+      }
+    }
+    // Binding the index buffer to GL_ELEMENT_ARRAY_BUFFER while the VAO is
+    // bound is enough to tell OpenGL we want to use that index buffer for
+    // that VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.indexBuffer.glId());
+
+    primitiveVaoIndices[i] = int(vertexArrayObjects.size());
+    attribMaskVaoIndices[attribMask] = primitiveVaoIndices[i];
+    vertexArrayObjects.emplace_back(std::move(vao));
   }
   glBindVertexArray(0);
 
@@ -140,10 +593,34 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects (
 
 int ViewerApplication::run()
 {
+  const auto startSeconds = glfwGetTime();
+  tinygltf::Model model;
+  GltfBuffers buffers;
+  GltfLoadProgress loadProgress;
+  // The file is loaded in parallel with other phases, their durations overlap
+  LoadReport loadReport;
+  auto isLoadReportDone = false;
+  // Loading the glTF file in the background, so that the window and the GUI
+  // are available right away. model, buffers and loadedLayout must not be
+  // accessed until the loading is done.
+  GeometryLayout loadedLayout;
+  auto loadingResult = std::async(std::launch::async, [&]() {
+    if (!loadGltfFile(model, buffers, &loadProgress, &loadReport)) {
+      return false;
+    }
+    ScopedPhaseTimer timer(&loadReport, "layoutGeometry");
+    loadedLayout = layoutGeometry(model, buffers);
+    return true;
+  });
+  auto isModelLoaded = false;
+  auto hasLoadingFailed = false;
+
   // Loader shaders
-  const auto glslProgram =
-      compileProgram({m_ShadersRootPath / m_vertexShader,
-          m_ShadersRootPath / m_fragmentShader});
+  const auto glslProgram = [&]() {
+    ScopedPhaseTimer timer(&loadReport, "compileProgram");
+    return compileProgram({m_ShadersRootPath / m_vertexShader,
+        m_ShadersRootPath / m_fragmentShader});
+  }();
 
   const auto modelViewProjMatrixLocation =
       glGetUniformLocation(glslProgram.glId(), "uModelViewProjMatrix");
@@ -151,6 +628,16 @@ int ViewerApplication::run()
       glGetUniformLocation(glslProgram.glId(), "uModelViewMatrix");
   const auto normalMatrixLocation =
       glGetUniformLocation(glslProgram.glId(), "uNormalMatrix");
+  const auto octahedralNormalsLocation =
+      glGetUniformLocation(glslProgram.glId(), "uOctahedralNormals");
+  // Quantized normals are octahedral, a shader reading normals without
+  // decoding them would silently shade with wrong ones
+  if (m_vertexFormat.isQuantized && octahedralNormalsLocation < 0 &&
+      isVertexAttribActive(glslProgram.glId(), VERTEX_ATTRIB_NORMAL)) {
+    throw std::runtime_error("Vertex shader " + m_vertexShader +
+                             " reads normals without a uOctahedralNormals "
+                             "uniform, required by --quantize-vertices");
+  }
 
   // Build projection matrix
   auto maxDistance = 500.f; // TODO use scene bounds instead to compute this
@@ -171,20 +658,144 @@ int ViewerApplication::run()
         Camera{glm::vec3(0, 0, 0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0)});
   }
 
-  tinygltf::Model model;
-  // TODO Loading the glTF file
-  bool test = loadGltfFile(model);
-  
-  // TODO Creation of Buffer Objects
-  auto bufferObjects = createBufferObjects(model);
+  // The geometry arena and Vertex Array Objects are created once the file is
+  // loaded, then the geometry is uploaded a chunk per frame
+  GeometryArena geometryArena;
+  GeometryLayout geometryLayout;
+  GeometryUploadState geometryUploadState;
+  StagingRing stagingRing{m_maxHostByteCount
+                              ? std::min(STAGING_RING_BYTE_COUNT,
+                                    m_maxHostByteCount)
+                              : STAGING_RING_BYTE_COUNT};
+  std::vector<GLVertexArray> vertexArrayObjects;
+  // Indexed like geometryLayout.primitives, VAOs are shared by primitives
+  std::vector<int> primitiveVaoIndices;
+  auto sceneIdx = -1; // Scene drawn, its geometry is uploaded first
+  FlatScene flatScene; // Of sceneIdx, drawn in the order of its nodes
+  // Level of detail drawn in the previous frame by each primitive of each
+  // node of flatScene, those of a node from its first one
+  std::vector<size_t> nodeFirstDrawnLods;
+  std::vector<size_t> drawnLods;
+
+  auto isHostDataReleased = false;
+
+  // Other scenes are loaded on demand, when selected
+  const auto selectScene = [&](int newSceneIdx) {
+    sceneIdx = newSceneIdx;
+    flatScene = flattenScene(model, sceneIdx);
+    nodeFirstDrawnLods.clear();
+    size_t drawnLodCount = 0;
+    for (const auto meshIdx : flatScene.meshes) {
+      nodeFirstDrawnLods.emplace_back(drawnLodCount);
+      drawnLodCount +=
+          meshIdx >= 0 ? model.meshes[meshIdx].primitives.size() : 0;
+    }
+    drawnLods.assign(drawnLodCount, 0);
+    requestSceneGeometry(model, sceneIdx, geometryLayout, geometryUploadState);
+  };
+  // Unless host data is released, which requires all scenes to be uploaded.
+  // The selected scene is still uploaded first.
+  const auto requestGeometry = [&]() {
+    selectScene(sceneIdx);
+    if (m_releaseHostData) {
+      for (size_t i = 0; i < model.scenes.size(); ++i) {
+        requestSceneGeometry(
+            model, int(i), geometryLayout, geometryUploadState);
+      }
+    }
+  };
+  // Return true if the arena had to be recreated, larger, to fit the blocks.
+  // All its blocks must then be uploaded again.
+  const auto allocateGeometry = [&](GeometryLayout &layout) {
+    if (allocateArenaBlocks(layout, geometryArena.vertexAllocator,
+            geometryArena.indexAllocator)) {
+      return false;
+    }
+    const auto vertexCapacity = std::max(getVertexCount(layout),
+        size_t(geometryArena.vertexCapacity * ARENA_GROWTH_FACTOR));
+    const auto indexCapacity = std::max(getIndexUnitCount(layout),
+        size_t(geometryArena.indexAllocator.capacity() * ARENA_GROWTH_FACTOR));
+    deleteGeometryArena(geometryArena);
+    geometryArena = createGeometryArena(vertexCapacity, indexCapacity);
+    for (auto *blocks : {&layout.vertexBlocks, &layout.indexBlocks}) {
+      for (auto &block : *blocks) {
+        block.isAllocated = false;
+        block.isUploaded = false;
+      }
+    }
+    allocateArenaBlocks(
+        layout, geometryArena.vertexAllocator, geometryArena.indexAllocator);
+    return true;
+  };
+
+  // Hot reload: once loaded, the files are watched and reloaded in the
+  // background when they change
+  FileWatcher fileWatcher;
+  auto lastChangeSeconds = -1.; // Negative if no change is pending
+  // Set when a watched file changes until the model is replaced. The pages of
+  // the files the model maps then show the new content, or fault if a file was
+  // truncated, so nothing more is uploaded from them.
+  auto isModelStale = false;
+  tinygltf::Model reloadedModel;
+  GltfBuffers reloadedBuffers;
+  GeometryLayout reloadedLayout;
+  std::future<bool> reloadingResult;
+
+  // Replace the model by the reloaded one. Blocks of the arena whose content
+  // is unchanged are kept, only the others are uploaded.
+  const auto replaceModel = [&]() {
+    reuseArenaBlocks(geometryLayout, reloadedLayout,
+        geometryArena.vertexAllocator, geometryArena.indexAllocator);
+    const auto isArenaRecreated = allocateGeometry(reloadedLayout);
+    size_t changedBlockCount = 0;
+    for (const auto *blocks :
+        {&reloadedLayout.vertexBlocks, &reloadedLayout.indexBlocks}) {
+      for (const auto &block : *blocks) {
+        changedBlockCount += block.isUploaded ? 0 : 1;
+      }
+    }
+
+    model = std::move(reloadedModel);
+    buffers = std::move(reloadedBuffers);
+    geometryLayout = std::move(reloadedLayout);
+    reloadedModel = tinygltf::Model{};
+    reloadedBuffers = GltfBuffers{};
+    reloadedLayout = GeometryLayout{};
+
+    for (auto &vao : vertexArrayObjects) {
+      m_glObjectPool.releaseVertexArray(std::move(vao));
+    }
+    vertexArrayObjects = createVertexArrayObjects(
+        geometryLayout, geometryArena, primitiveVaoIndices);
+    geometryUploadState = GeometryUploadState{};
+    if (sceneIdx < 0 || size_t(sceneIdx) >= model.scenes.size()) {
+      sceneIdx = model.defaultScene;
+    }
+    requestGeometry();
+    isHostDataReleased = false;
+    isModelStale = false;
+    isModelLoaded = true;
+    hasLoadingFailed = false;
+
+    std::clog << "Reloaded " << m_gltfFilePath << ", " << changedBlockCount
+              << " of "
+              << geometryLayout.vertexBlocks.size() +
+                     geometryLayout.indexBlocks.size()
+              << " geometry blocks changed"
+              << (isArenaRecreated ? ", arena recreated" : "") << "\n";
+  };
 
-  // TODO Creation of Vertex Array Objects
-  std::vector<VaoRange> meshIndexToVaoRange;
-  auto vertexArrayObjects = createVertexArrayObjects(model, bufferObjects, meshIndexToVaoRange);
+  // GPU time of drawScene in the frames measured by the benchmark
+  GLQuery timerQuery;
+  if (m_benchmarkFrameCount) {
+    timerQuery = GLQuery::generate();
+  }
+  std::vector<double> benchmarkSeconds;
 
   // Setup OpenGL state for rendering
   glEnable(GL_DEPTH_TEST);
   glslProgram.use();
+  glUniform1i(octahedralNormalsLocation, m_vertexFormat.isQuantized);
 
   // Lambda function to draw the scene
   const auto drawScene = [&](const Camera &camera) {
@@ -193,65 +804,96 @@ int ViewerApplication::run()
 
     const auto viewMatrix = camera.getViewMatrix();
 
-    // The recursive function that should draw a node
-    // We use a std::function because a simple lambda cannot be recursive
-    const std::function<void(int, const glm::mat4 &)> drawNode =
-        [&](int nodeIdx, const glm::mat4 &parentMatrix) {
-          const auto& node = model.nodes[nodeIdx];
-          const auto& modelMatrix = getLocalToWorldMatrix(node, parentMatrix);
-
-          if (node.mesh >= 0) {
-            const auto modelViewMatrix           = viewMatrix * modelMatrix;
-            const auto modelViewProjectionMatrix = projMatrix * modelViewMatrix;
-            const auto normalMatrix              = glm::transpose(glm::inverse(modelViewMatrix));
-
-            glUniformMatrix4fv(modelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelViewProjectionMatrix));
-            glUniformMatrix4fv(modelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelViewMatrix));
-            glUniformMatrix4fv(normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-
-            auto& mesh = model.meshes[node.mesh];
-            auto& range = meshIndexToVaoRange[node.mesh];
-            
-            for(size_t pIdx = 0; pIdx < mesh.primitives.size(); ++pIdx) {
-              std::cout << "Test" << std::endl;
-              auto& vao = vertexArrayObjects[range.begin + pIdx];
-              auto& primitive = mesh.primitives[pIdx];
+    // VAOs are shared by primitives, bind them only when they change
+    GLuint boundVao = 0;
+
+    // Draw arguments of the visible meshlets of a primitive
+    std::vector<uint32_t> meshletFirstIndices;
+    std::vector<GLsizei> meshletIndexCounts;
+    std::vector<const GLvoid *> meshletOffsets;
+    std::vector<GLint> meshletBaseVertices;
+
+    // Draw the selected scene, the one referenced by gltf file by default.
+    // Its nodes are flattened with their world matrices, parents first.
+    if (isModelLoaded && sceneIdx >= 0) {
+      for (size_t nodeEntry = 0; nodeEntry < flatScene.meshes.size(); ++nodeEntry) {
+        const auto  meshIdx = flatScene.meshes[nodeEntry];
+        const auto& modelMatrix = flatScene.worldMatrices[nodeEntry];
+
+        if (meshIdx >= 0 && isMeshUploaded(geometryLayout, meshIdx)) {
+          const auto modelViewMatrix           = viewMatrix * modelMatrix;
+          const auto modelViewProjectionMatrix = projMatrix * modelViewMatrix;
+          const auto normalMatrix              = glm::transpose(glm::inverse(modelViewMatrix));
+
+          glUniformMatrix4fv(modelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelViewProjectionMatrix));
+          glUniformMatrix4fv(modelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelViewMatrix));
+          glUniformMatrix4fv(normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+
+          auto& mesh = model.meshes[meshIdx];
+          const auto firstPrimitiveIdx = geometryLayout.meshFirstPrimitives[meshIdx];
+
+          for(size_t pIdx = 0; pIdx < mesh.primitives.size(); ++pIdx) {
+            auto& primitive = geometryLayout.primitives[firstPrimitiveIdx + pIdx];
+            if (primitive.vertexBlock < 0) {
+              continue;
+            }
+            const auto& vertexBlock = geometryLayout.vertexBlocks[primitive.vertexBlock];
 
+            const auto vao = vertexArrayObjects[primitiveVaoIndices[firstPrimitiveIdx + pIdx]].glId();
+            if (vao != boundVao) {
               glBindVertexArray(vao);
-              std::cout << "VAO Bound" << std::endl;
-
-              if (primitive.indices >= 0) {
-                auto& accessor   = model.accessors[primitive.indices];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto  byteOffset = accessor.byteOffset + bufferView.byteOffset;
-                std::cout << "Draw elements" << std::endl;
-
-                glDrawElements(primitive.mode, GLsizei(accessor.count), accessor.componentType, (const GLvoid*) byteOffset);
-              } else {
-                const auto  accessorIdx = (*begin(primitive.attributes)).second;
-                const auto& accessor    = model.accessors[accessorIdx];
-                std::cout << "Draw arrays" << std::endl;
-                glDrawArrays(primitive.mode, 0, accessor.count);
-              }
+              boundVao = vao;
+            }
+
+            // Quantized positions are in the bounds of their vertex block
+            if (geometryArena.vertexFormat.isQuantized) {
+              const auto dequantizedModelViewMatrix = modelViewMatrix * getDequantizationMatrix(geometryArena.vertexFormat, vertexBlock);
 
-              glBindVertexArray(0);
-              std::cout << "Draw call OK" << std::endl;
+              glUniformMatrix4fv(modelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(projMatrix * dequantizedModelViewMatrix));
+              glUniformMatrix4fv(modelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(dequantizedModelViewMatrix));
             }
 
-            std::cout << "End Test" << std::endl;
-          }
+            // Levels of detail are selected by their error on screen, in
+            // the space of the original positions
+            auto lod = size_t(0);
+            if (!primitive.lods.empty()) {
+              const auto pixelsPerUnit = computeLodPixelsPerUnit(vertexBlock, modelViewMatrix, projMatrix, float(m_nWindowHeight));
+              auto& drawnLod = drawnLods[nodeFirstDrawnLods[nodeEntry] + pIdx];
+              lod = drawnLod = selectLod(primitive, pixelsPerUnit, drawnLod);
+            }
 
-          for (auto child: node.children) {
-            drawNode(child, modelMatrix);
-          }
-        };
+            // Every primitive is at an offset of the arena buffers. Indices
+            // are rebased to their min, which the base vertex adds back.
+            if (primitive.indexBlock >= 0) {
+              const auto  indexBlockIdx = lod ? primitive.lods[lod - 1].indexBlock : primitive.indexBlock;
+              const auto& indexBlock = geometryLayout.indexBlocks[indexBlockIdx];
+              const auto  byteOffset = indexBlock.first * ARENA_INDEX_UNIT_BYTE_SIZE;
+              const auto  baseVertex = vertexBlock.first + indexBlock.minIndex;
+
+              // Meshlets split the base level only
+              if (primitive.meshlets.empty() || lod) {
+                glDrawRangeElementsBaseVertex(primitive.mode, 0, indexBlock.maxIndex - indexBlock.minIndex, GLsizei(indexBlock.count), getIndexType(indexBlock), (const GLvoid*) byteOffset, GLint(baseVertex));
+                continue;
+              }
 
-    // Draw the scene referenced by gltf file
-    if (model.defaultScene >= 0) {
-      for (auto& node: model.scenes[model.defaultScene].nodes) {
-        drawNode(node, glm::mat4(1));
+              // Only meshlets that may be visible are drawn, their bounds
+              // are in the space of the original positions
+              const auto cameraPosition = glm::vec3(glm::inverse(modelViewMatrix)[3]);
+              cullMeshlets(primitive.meshlets, modelViewProjectionMatrix, cameraPosition, meshletFirstIndices, meshletIndexCounts);
+              meshletOffsets.clear();
+              for (const auto firstIndex : meshletFirstIndices) {
+                meshletOffsets.emplace_back((const GLvoid*) (byteOffset + firstIndex * indexBlock.indexByteSize));
+              }
+              meshletBaseVertices.assign(meshletOffsets.size(), GLint(baseVertex));
+              glMultiDrawElementsBaseVertex(primitive.mode, meshletIndexCounts.data(), getIndexType(indexBlock), meshletOffsets.data(), GLsizei(meshletOffsets.size()), meshletBaseVertices.data());
+            } else {
+              glDrawArrays(primitive.mode, GLint(vertexBlock.first), GLsizei(vertexBlock.count));
+            }
+          }
+        }
       }
     }
+    glBindVertexArray(0);
   };
 
   // Loop until the user closes the window
@@ -259,8 +901,130 @@ int ViewerApplication::run()
        ++iterationCount) {
     const auto seconds = glfwGetTime();
 
+    if (loadingResult.valid() && loadingResult.wait_for(std::chrono::seconds(
+                                     0)) == std::future_status::ready) {
+      isModelLoaded = loadingResult.get();
+      hasLoadingFailed = !isModelLoaded;
+      fileWatcher = watchGltfFiles();
+      if (isModelLoaded) {
+        addModelCounts(model, buffers, loadReport);
+        {
+          ScopedPhaseTimer timer(&loadReport, "createGeometryArena");
+          geometryLayout = std::move(loadedLayout);
+          allocateGeometry(geometryLayout);
+        }
+        {
+          ScopedPhaseTimer timer(&loadReport, "createVertexArrayObjects");
+          vertexArrayObjects = createVertexArrayObjects(
+              geometryLayout, geometryArena, primitiveVaoIndices);
+        }
+        sceneIdx = model.defaultScene;
+        requestGeometry();
+      }
+    }
+
+    if (fileWatcher.hasChanged()) {
+      lastChangeSeconds = seconds;
+      isModelStale = !buffers.mappedFiles.empty();
+    }
+    if (lastChangeSeconds >= 0 && !reloadingResult.valid() &&
+        seconds - lastChangeSeconds > RELOAD_DELAY_SECONDS) {
+      lastChangeSeconds = -1.;
+      reloadingResult = std::async(std::launch::async, [&]() {
+        if (!reloadGltfFile(reloadedModel, reloadedBuffers)) {
+          return false;
+        }
+        reloadedLayout = layoutGeometry(reloadedModel, reloadedBuffers);
+        return true;
+      });
+    }
+    if (reloadingResult.valid() &&
+        reloadingResult.wait_for(std::chrono::seconds(0)) ==
+            std::future_status::ready) {
+      // On failure, the current model is kept until the next change. A change
+      // during the reload may have torn what it read, it is reloaded again.
+      if (reloadingResult.get() && lastChangeSeconds < 0) {
+        replaceModel();
+      } else {
+        reloadedModel = tinygltf::Model{};
+        reloadedBuffers = GltfBuffers{};
+        reloadedLayout = GeometryLayout{};
+      }
+      fileWatcher = watchGltfFiles(); // References to files may have changed
+    }
+
+    auto isUploaded = false;
+    if (isModelLoaded && !isModelStale) {
+      ScopedPhaseTimer timer(
+          isLoadReportDone ? nullptr : &loadReport, "uploadGeometry");
+      isUploaded = uploadGeometry(model, buffers, geometryArena, stagingRing,
+          UPLOAD_BYTE_COUNT_PER_FRAME, geometryLayout, geometryUploadState);
+    }
+    if (m_releaseHostData && isUploaded && !isHostDataReleased) {
+      isHostDataReleased = true;
+      const auto hostByteCount = computeHostByteCount(model, buffers);
+      releaseHostData(model, buffers);
+      const auto releasedHostByteCount = computeHostByteCount(model, buffers);
+      std::clog << "Released host data, " << (hostByteCount >> 20)
+                << " MB before, " << (releasedHostByteCount >> 20)
+                << " MB after\n";
+      if (!isLoadReportDone) {
+        loadReport.setCount("hostBytesBeforeRelease", hostByteCount);
+        loadReport.setCount("hostBytesAfterRelease", releasedHostByteCount);
+      }
+    }
+    // The report covers the loading up to the upload of the requested
+    // geometry, of the default scene or of all scenes
+    if (!isLoadReportDone && (isUploaded || hasLoadingFailed)) {
+      isLoadReportDone = true;
+      loadReport.addPhase("total", glfwGetTime() - startSeconds);
+      loadReport.setCount(
+          "uploadedBytes", geometryUploadState.uploadedByteCount);
+      loadReport.setCount("bufferObjects",
+          size_t(bool(geometryArena.vertexBuffer)) +
+              size_t(bool(geometryArena.indexBuffer)));
+      loadReport.setCount("bufferObjectBytes",
+          getArenaVertexBufferSize(
+              geometryArena.vertexFormat, geometryArena.vertexCapacity) +
+              geometryArena.indexAllocator.capacity() *
+                  ARENA_INDEX_UNIT_BYTE_SIZE);
+      loadReport.setCount("stagingRingBytes", stagingRing.capacity());
+      loadReport.setCount("vertexBlocks", geometryLayout.vertexBlocks.size());
+      loadReport.setCount("indexBlocks", geometryLayout.indexBlocks.size());
+      loadReport.setCount("narrowedIndexBlocks",
+          std::count_if(begin(geometryLayout.indexBlocks),
+              end(geometryLayout.indexBlocks), [](const ArenaBlock &block) {
+                return block.indexByteSize < sizeof(uint32_t);
+              }));
+      loadReport.setCount("vertexArrayObjects", vertexArrayObjects.size());
+      std::string err;
+      if (!m_loadReportPath.empty() &&
+          !loadReport.write(m_loadReportPath, err)) {
+        std::cerr << err;
+      }
+    }
+
     const auto camera = cameraController.getCamera();
+    const auto isBenchmarkFrame =
+        isUploaded && benchmarkSeconds.size() < m_benchmarkFrameCount;
+    if (isBenchmarkFrame) {
+      glBeginQuery(GL_TIME_ELAPSED, timerQuery.glId());
+    }
     drawScene(camera);
+    if (isBenchmarkFrame) {
+      glEndQuery(GL_TIME_ELAPSED);
+      // Waits for the GPU, which does not matter for the measure
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(timerQuery.glId(), GL_QUERY_RESULT, &nanoseconds);
+      benchmarkSeconds.push_back(nanoseconds * 1e-9);
+      if (benchmarkSeconds.size() == m_benchmarkFrameCount) {
+        printBenchmarkResult(benchmarkSeconds);
+        glfwSetWindowShouldClose(m_GLFWHandle.window(), 1);
+      }
+    }
+    if (m_benchmarkFrameCount && hasLoadingFailed) {
+      glfwSetWindowShouldClose(m_GLFWHandle.window(), 1);
+    }
 
     // GUI code:
     imguiNewFrame();
@@ -269,6 +1033,31 @@ int ViewerApplication::run()
       ImGui::Begin("GUI");
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
           1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+      if (hasLoadingFailed) {
+        ImGui::Text("Failed to load %s", m_gltfFilePath.string().c_str());
+      } else if (!isModelLoaded) {
+        const size_t imageCount = loadProgress.imageCount;
+        if (imageCount == 0) {
+          ImGui::Text("Parsing %s", m_gltfFilePath.string().c_str());
+        } else {
+          const size_t decodedImageCount = loadProgress.decodedImageCount;
+          ImGui::Text("Decoding images");
+          ImGui::ProgressBar(float(decodedImageCount) / imageCount);
+        }
+      } else if (geometryUploadState.uploadedByteCount <
+                 geometryUploadState.totalByteCount) {
+        ImGui::Text("Uploading geometry");
+        ImGui::ProgressBar(float(geometryUploadState.uploadedByteCount) /
+                           geometryUploadState.totalByteCount);
+      }
+      if (isModelLoaded && model.scenes.size() > 1) {
+        auto selectedSceneIdx = sceneIdx;
+        if (ImGui::SliderInt("Scene", &selectedSceneIdx, 0,
+                int(model.scenes.size()) - 1) &&
+            selectedSceneIdx != sceneIdx) {
+          selectScene(selectedSceneIdx);
+        }
+      }
       if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Text("eye: %.3f %.3f %.3f", camera.eye().x, camera.eye().y,
             camera.eye().z);
@@ -309,15 +1098,19 @@ int ViewerApplication::run()
     m_GLFWHandle.swapBuffers(); // Swap front and back buffers
   }
 
-  // TODO clean up allocated GL data
-
+  // GL objects are deleted by their owners, before the GL context
   return 0;
 }
 
 ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width,
     uint32_t height, const fs::path &gltfFile,
     const std::vector<float> &lookatArgs, const std::string &vertexShader,
-    const std::string &fragmentShader, const fs::path &output) :
+    const std::string &fragmentShader, const fs::path &output,
+    const fs::path &cacheDirectory, const fs::path &loadReport,
+    uint32_t maxHostMB, bool releaseHostData, const VertexFormat &vertexFormat,
+    uint32_t benchmarkFrameCount, bool optimizeVertexCache,
+    bool optimizeOverdraw, bool optimizeVertexFetch, bool buildMeshlets,
+    bool buildLods) :
     m_nWindowWidth(width),
     m_nWindowHeight(height),
     m_AppPath{appPath},
@@ -325,7 +1118,18 @@ ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width,
     m_ImGuiIniFilename{m_AppName + ".imgui.ini"},
     m_ShadersRootPath{m_AppPath.parent_path() / "shaders"},
     m_gltfFilePath{gltfFile},
-    m_OutputPath{output}
+    m_OutputPath{output},
+    m_cacheDirectory{cacheDirectory},
+    m_loadReportPath{loadReport},
+    m_maxHostByteCount{size_t(maxHostMB) * 1024 * 1024},
+    m_releaseHostData{releaseHostData},
+    m_vertexFormat{vertexFormat},
+    m_benchmarkFrameCount{benchmarkFrameCount},
+    m_optimizeVertexCache{optimizeVertexCache},
+    m_optimizeOverdraw{optimizeOverdraw},
+    m_optimizeVertexFetch{optimizeVertexFetch},
+    m_buildMeshlets{buildMeshlets},
+    m_buildLods{buildLods}
 {
   if (!lookatArgs.empty()) {
     m_hasUserCamera = true;
@@ -2,8 +2,16 @@
 
 #include "utils/GLFWHandle.hpp"
 #include "utils/cameras.hpp"
+#include "utils/file_watcher.hpp"
 #include "utils/filesystem.hpp"
+#include "utils/geometry_arena.hpp"
+#include "utils/gl_objects.hpp"
+#include "utils/gltf.hpp"
+#include "utils/gltf_loader.hpp"
+#include "utils/load_report.hpp"
+#include "utils/scene_cache.hpp"
 #include "utils/shaders.hpp"
+#include "utils/staging_ring.hpp"
 
 #include <tiny_gltf.h>
 
@@ -13,16 +21,46 @@ public:
   ViewerApplication(const fs::path &appPath, uint32_t width, uint32_t height,
       const fs::path &gltfFile, const std::vector<float> &lookatArgs,
       const std::string &vertexShader, const std::string &fragmentShader,
-      const fs::path &output);
+      const fs::path &output, const fs::path &cacheDirectory,
+      const fs::path &loadReport, uint32_t maxHostMB, bool releaseHostData,
+      const VertexFormat &vertexFormat, uint32_t benchmarkFrameCount,
+      bool optimizeVertexCache, bool optimizeOverdraw,
+      bool optimizeVertexFetch, bool buildMeshlets, bool buildLods);
 
   int run();
 
 private:
-  // A range of indices in a vector containing Vertex Array Objects
-  struct VaoRange
+  // One vertex buffer and one index buffer holding the geometry of every
+  // primitive, suballocated in blocks, so that all draws share the same
+  // buffer bindings
+  struct GeometryArena
   {
-    GLsizei begin; // Index of first element in vertexArrayObjects
-    GLsizei count; // Number of elements in range
+    VertexFormat vertexFormat;
+    GLBuffer vertexBuffer; // vertexCapacity vertices in vertexFormat
+    GLBuffer indexBuffer;
+    size_t vertexCapacity = 0;
+    RangeAllocator vertexAllocator; // In vertices
+    RangeAllocator indexAllocator; // In indices
+  };
+
+  // Progression of the upload of the geometry to the arena. Only the blocks
+  // read by the selected scenes are requested, and they are uploaded in order,
+  // chunk by chunk through a staging ring.
+  struct GeometryUploadState
+  {
+    struct Request
+    {
+      int blockIdx;
+      bool isIndexBlock;
+    };
+    std::vector<Request> requests; // In upload order
+    size_t requestIdx = 0; // Requests before this one are fully uploaded
+    // Attribute of the vertex block being uploaded, always 0 for index blocks
+    // and interleaved vertex blocks
+    int streamIdx = 0;
+    size_t elementOffset = 0; // Uploaded elements of stream streamIdx
+    size_t uploadedByteCount = 0;
+    size_t totalByteCount = 0;
   };
 
   GLsizei m_nWindowWidth = 1280;
@@ -40,6 +78,25 @@ private:
   Camera m_userCamera;
 
   fs::path m_OutputPath;
+  fs::path m_cacheDirectory; // Scene cache is disabled if empty
+  fs::path m_loadReportPath; // No load report is written if empty
+  // Geometry is streamed to the GPU in chunks of at most this size, through a
+  // staging ring of at most this size, 0 for no limit
+  size_t m_maxHostByteCount = 0;
+  // Geometry of all scenes is uploaded, then buffers and images are released
+  // from host memory
+  bool m_releaseHostData = false;
+  VertexFormat m_vertexFormat; // Of the geometry arena
+  // If not 0, the GPU time of drawing the scene is measured over this number
+  // of frames once its geometry is uploaded, then the application exits
+  uint32_t m_benchmarkFrameCount = 0;
+  // Import stages run on loaded models, their result is stored in the scene
+  // cache
+  bool m_optimizeVertexCache = false;
+  bool m_optimizeOverdraw = false; // Implies m_optimizeVertexCache
+  bool m_optimizeVertexFetch = false;
+  bool m_buildMeshlets = false; // Also culled when drawing
+  bool m_buildLods = false; // Also selected when drawing
 
   // Order is important here, see comment below
   const std::string m_ImGuiIniFilename;
@@ -47,6 +104,10 @@ private:
   GLFWHandle m_GLFWHandle{int(m_nWindowWidth), int(m_nWindowHeight),
       "glTF Viewer",
       m_OutputPath.empty()}; // show the window only if m_OutputPath is empty
+  // Buffers and vertex arrays released when the geometry arena is recreated
+  // or a model is reloaded, after m_GLFWHandle so that they are deleted while
+  // the GL context exists
+  GLObjectPool m_glObjectPool;
   /*
     ! THE ORDER OF DECLARATION OF MEMBER VARIABLES IS IMPORTANT !
     - m_ImGuiIniFilename.c_str() will be used by ImGUI in ImGui::Shutdown, which
@@ -58,7 +119,16 @@ private:
     the creation of a GLFW windows and thus a GL context which must exists
     before most of OpenGL function calls.
   */
- bool loadGltfFile(tinygltf::Model& model);
- std::vector<GLuint> createBufferObjects(const tinygltf::Model &model);
- std::vector<GLuint> createVertexArrayObjects (const tinygltf::Model& model, const std::vector<GLuint>& bufferObjects, std::vector<VaoRange>& meshIndexToVaoRange);
+ bool loadGltfFile(tinygltf::Model& model, GltfBuffers& buffers, GltfLoadProgress* progress = nullptr, LoadReport* report = nullptr);
+ bool reloadGltfFile(tinygltf::Model& model, GltfBuffers& buffers);
+ void runImportStages(tinygltf::Model &model, GltfBuffers &buffers, LoadReport *report = nullptr);
+ FileWatcher watchGltfFiles();
+ // Reads the whole geometry, called from the loading threads
+ GeometryLayout layoutGeometry(const tinygltf::Model &model, const GltfBuffers &buffers);
+ GeometryArena createGeometryArena(size_t vertexCapacity, size_t indexCapacity);
+ void deleteGeometryArena(GeometryArena &arena);
+ void requestSceneGeometry(const tinygltf::Model &model, int sceneIdx, GeometryLayout &layout, GeometryUploadState &uploadState);
+ bool uploadGeometry(const tinygltf::Model &model, const GltfBuffers &buffers, const GeometryArena &arena, StagingRing &stagingRing, size_t maxByteCount, GeometryLayout &layout, GeometryUploadState &uploadState);
+ // One VAO per distinct set of vertex attributes, primitiveVaoIndices gives the VAO of each primitive of the layout
+ std::vector<GLVertexArray> createVertexArrayObjects(const GeometryLayout &layout, const GeometryArena &arena, std::vector<int> &primitiveVaoIndices);
 };
\ No newline at end of file
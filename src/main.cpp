@@ -1,5 +1,6 @@
 #include "ViewerApplication.hpp"
 #include "utils/GLFWHandle.hpp"
+#include "utils/benchmarks.hpp"
 #include "utils/filesystem.hpp"
 
 #include <args.hxx>
@@ -43,6 +44,59 @@ int main(int argc, char **argv)
             "Output path to render the image. If specified no window is shown. "
             "Only png is supported.",
             {"o", "output"}};
+        args::ValueFlag<std::string> cacheDirectory{parser, "cache-dir",
+            "Directory of the scene cache. Loaded scenes are stored there, "
+            "ready to upload, and loaded from there on next runs.",
+            {"cache-dir"}};
+        args::ValueFlag<std::string> loadReport{parser, "load-report",
+            "Output path of a JSON report of the duration of each loading "
+            "phase, and of the number of bytes and objects loaded.",
+            {"load-report"}};
+        args::ValueFlag<uint32_t> maxHostMB{parser, "max-host-mb",
+            "Stream geometry to the GPU through a staging ring of at most "
+            "this number of MB, reading at most this number of MB of buffer "
+            "data in memory at a time.",
+            {"max-host-mb"}};
+        args::Flag releaseHostData{parser, "release-host-data",
+            "Release buffers and images from memory once all scenes are "
+            "uploaded to the GPU.",
+            {"release-host-data"}};
+        args::Flag interleaveVertices{parser, "interleave-vertices",
+            "Interleave the attributes of each vertex in a single stream on "
+            "the GPU, instead of storing each attribute in its own region.",
+            {"interleave-vertices"}};
+        args::Flag quantizeVertices{parser, "quantize-vertices",
+            "Quantize positions and normals to 16 bits integers, and texture "
+            "coordinates to half floats, on the GPU.",
+            {"quantize-vertices"}};
+        args::Flag optimizeVertexCache{parser, "optimize-vertex-cache",
+            "Reorder triangles for the post-transform vertex cache when "
+            "loading, stored in the scene cache if enabled.",
+            {"optimize-vertex-cache"}};
+        args::Flag optimizeOverdraw{parser, "optimize-overdraw",
+            "Also reorder clusters of triangles so that front-most ones are "
+            "drawn first, reducing overdraw at the cost of a few more vertex "
+            "cache misses.",
+            {"optimize-overdraw"}};
+        args::Flag optimizeVertexFetch{parser, "optimize-vertex-fetch",
+            "Renumber vertices in the order triangles first use them, "
+            "removing unused ones, so that vertex memory is read mostly in "
+            "order.",
+            {"optimize-vertex-fetch"}};
+        args::Flag buildMeshlets{parser, "build-meshlets",
+            "Split primitives into meshlets of at most 64 vertices and 124 "
+            "triangles, reordered for the vertex cache, and skip those out "
+            "of view or facing away when drawing.",
+            {"build-meshlets"}};
+        args::Flag buildLods{parser, "build-lods",
+            "Build simplified levels of detail of primitives, sharing their "
+            "vertices, and draw each one with the coarsest level whose error "
+            "is under a pixel on screen.",
+            {"build-lods"}};
+        args::ValueFlag<uint32_t> benchFrames{parser, "bench-frames",
+            "Measure the GPU time of drawing the scene over this number of "
+            "frames once its geometry is uploaded, print it and exit.",
+            {"bench-frames"}};
         parser.Parse();
 
         std::vector<float> lookatParams;
@@ -62,11 +116,63 @@ int main(int argc, char **argv)
         uint32_t width = imageWidth ? args::get(imageWidth) : 1280;
         uint32_t height = imageHeight ? args::get(imageHeight) : 720;
 
+        VertexFormat vertexFormat;
+        vertexFormat.isInterleaved = args::get(interleaveVertices);
+        vertexFormat.isQuantized = args::get(quantizeVertices);
+
         ViewerApplication app{fs::path{argv[0]}, width, height, args::get(file),
             lookatParams, args::get(vertexShader), args::get(fragmentShader),
-            args::get(output)};
+            args::get(output), args::get(cacheDirectory),
+            args::get(loadReport), args::get(maxHostMB),
+            args::get(releaseHostData), vertexFormat, args::get(benchFrames),
+            args::get(optimizeVertexCache), args::get(optimizeOverdraw),
+            args::get(optimizeVertexFetch), args::get(buildMeshlets),
+            args::get(buildLods)};
         returnCode = app.run();
       }};
+  args::Command benchBase64{commands, "bench-base64",
+      "Benchmark base64 decoding of data URIs", [&](args::Subparser &parser) {
+        args::ValueFlag<size_t> size{parser, "size",
+            "Size of the decoded payload in MB (default 100)", {"size"}};
+        parser.Parse();
+
+        const size_t sizeMB = size ? args::get(size) : 100;
+        returnCode = benchmarkBase64Decoding(sizeMB << 20) ? 0 : 1;
+      }};
+  args::Command benchScene{commands, "bench-scene",
+      "Write a vertex bound glTF scene to benchmark the viewer with",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> file{
+            parser, "file", "Path of the glTF file", args::Options::Required};
+        args::ValueFlag<size_t> grid{parser, "grid",
+            "Number of vertices along each side of the grid (default 1024)",
+            {"grid"}};
+        parser.Parse();
+
+        std::string err;
+        if (!writeVertexBenchmarkScene(
+                args::get(file), grid ? args::get(grid) : 1024, err)) {
+          std::cerr << err << std::endl;
+          returnCode = 1;
+        }
+      }};
+  args::Command benchInteriorScene{commands, "bench-interior-scene",
+      "Write an overdraw bound glTF interior scene to benchmark the viewer "
+      "with",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> file{
+            parser, "file", "Path of the glTF file", args::Options::Required};
+        args::ValueFlag<size_t> objects{parser, "objects",
+            "Number of spheres in the room (default 256)", {"objects"}};
+        parser.Parse();
+
+        std::string err;
+        if (!writeOverdrawBenchmarkScene(
+                args::get(file), objects ? args::get(objects) : 256, err)) {
+          std::cerr << err << std::endl;
+          returnCode = 1;
+        }
+      }};
 
   try {
     parser.ParseCLI(argc, argv);
@@ -11,11 +11,24 @@ out vec2 vTexCoords;
 uniform mat4 uModelViewProjMatrix;
 uniform mat4 uModelViewMatrix;
 uniform mat4 uNormalMatrix;
+// Normals are octahedral coordinates in aNormal.xy if vertices are quantized
+uniform bool uOctahedralNormals;
+
+vec3 decodeOctahedral(vec2 coords)
+{
+    vec3 normal = vec3(coords, 1 - abs(coords.x) - abs(coords.y));
+    if (normal.z < 0) {
+        vec2 signs = vec2(normal.x >= 0 ? 1 : -1, normal.y >= 0 ? 1 : -1);
+        normal.xy = (1 - abs(normal.yx)) * signs;
+    }
+    return normal;
+}
 
 void main()
 {
+    vec3 normal = uOctahedralNormals ? decodeOctahedral(aNormal.xy) : aNormal;
     vViewSpacePosition = vec3(uModelViewMatrix * vec4(aPosition, 1));
-	vViewSpaceNormal = normalize(vec3(uNormalMatrix * vec4(aNormal, 0)));
+	vViewSpaceNormal = normalize(vec3(uNormalMatrix * vec4(normal, 0)));
 	vTexCoords = aTexCoords;
     gl_Position =  uModelViewProjMatrix * vec4(aPosition, 1);
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 330
+
+in vec3 vViewSpacePosition;
+in vec3 vViewSpaceNormal;
+in vec2 vTexCoords;
+
+out vec3 fColor;
+
+// Enough lights for drawing to be bound by shading fragments, which makes
+// overdraw visible in benchmarks
+const int LIGHT_COUNT = 128;
+
+void main()
+{
+   vec3 viewSpaceNormal = normalize(vViewSpaceNormal);
+   vec3 viewDirection = normalize(-vViewSpacePosition);
+   vec3 color = vec3(0);
+   for (int i = 0; i < LIGHT_COUNT; ++i) {
+      // Lights along a spiral in front of the camera
+      float angle = 0.5 * float(i);
+      vec3 lightPosition = vec3(3 * cos(angle), 3 * sin(angle), -0.05 * float(i));
+      vec3 lightColor = 0.5 + 0.5 * cos(vec3(angle, angle + 2, angle + 4));
+      vec3 toLight = lightPosition - vViewSpacePosition;
+      float squaredDistance = dot(toLight, toLight);
+      vec3 lightDirection = toLight * inversesqrt(squaredDistance);
+      vec3 halfVector = normalize(lightDirection + viewDirection);
+      float diffuse = max(dot(viewSpaceNormal, lightDirection), 0);
+      float specular = pow(max(dot(viewSpaceNormal, halfVector), 0), 32);
+      color += lightColor * (diffuse + specular) / (1 + squaredDistance);
+   }
+   fColor = color;
+}
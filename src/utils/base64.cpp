@@ -0,0 +1,292 @@
+#include "base64.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||             \
+    defined(_M_IX86)
+#define BASE64_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(BASE64_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BASE64_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BASE64_TARGET(isa)
+#endif
+
+namespace
+{
+
+const unsigned char INVALID = 0xFF;
+
+struct DecodingTable
+{
+  unsigned char values[256];
+
+  DecodingTable()
+  {
+    const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::memset(values, INVALID, sizeof(values));
+    for (unsigned char i = 0; i < 64; ++i) {
+      values[static_cast<unsigned char>(alphabet[i])] = i;
+    }
+  }
+};
+
+const DecodingTable DECODING_TABLE;
+
+// Length of src without its '=' padding
+size_t unpaddedSize(const char *src, size_t size)
+{
+  if (size >= 1 && src[size - 1] == '=') {
+    --size;
+    if (size >= 1 && src[size - 1] == '=') {
+      --size;
+    }
+  }
+  return size;
+}
+
+// Decode an unpadded base64 string whose size % 4 != 1
+bool decodeScalar(const char *src, size_t size, unsigned char *dst)
+{
+  const auto *table = DECODING_TABLE.values;
+  const auto *s = reinterpret_cast<const unsigned char *>(src);
+  const auto *end = s + size / 4 * 4;
+  for (; s != end; s += 4, dst += 3) {
+    const unsigned a = table[s[0]], b = table[s[1]], c = table[s[2]],
+                   d = table[s[3]];
+    if ((a | b | c | d) & 0xC0) { // INVALID has these bits set
+      return false;
+    }
+    const auto bits = (a << 18) | (b << 12) | (c << 6) | d;
+    dst[0] = static_cast<unsigned char>(bits >> 16);
+    dst[1] = static_cast<unsigned char>(bits >> 8);
+    dst[2] = static_cast<unsigned char>(bits);
+  }
+  const auto remainder = size % 4;
+  if (remainder >= 2) {
+    const unsigned a = table[s[0]], b = table[s[1]],
+                   c = remainder == 3 ? table[s[2]] : 0;
+    if ((a | b | c) & 0xC0) {
+      return false;
+    }
+    const auto bits = (a << 18) | (b << 12) | (c << 6);
+    dst[0] = static_cast<unsigned char>(bits >> 16);
+    if (remainder == 3) {
+      dst[1] = static_cast<unsigned char>(bits >> 8);
+    }
+  }
+  return true;
+}
+
+#ifdef BASE64_X86
+
+// The characters are translated to their 6 bits values by adding an offset
+// depending on their range: -65 for A-Z, -71 for a-z, +4 for 0-9, +19 for '+'
+// and +16 for '/'. Ranges are compared as signed bytes, which is fine since
+// the alphabet is ASCII.
+
+BASE64_TARGET("ssse3")
+inline __m128i inRange128(__m128i chars, char first, char last)
+{
+  return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(first - 1)),
+      _mm_cmplt_epi8(chars, _mm_set1_epi8(last + 1)));
+}
+
+// Translate 16 base64 characters to their 6 bits values. Characters out of
+// the alphabet set their bit in invalidMask.
+BASE64_TARGET("ssse3")
+inline __m128i decodeValues128(__m128i chars, int &invalidMask)
+{
+  const auto upper = inRange128(chars, 'A', 'Z');
+  const auto lower = inRange128(chars, 'a', 'z');
+  const auto digit = inRange128(chars, '0', '9');
+  const auto plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+  const auto slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+
+  auto offsets = _mm_and_si128(upper, _mm_set1_epi8(-65));
+  offsets = _mm_or_si128(offsets, _mm_and_si128(lower, _mm_set1_epi8(-71)));
+  offsets = _mm_or_si128(offsets, _mm_and_si128(digit, _mm_set1_epi8(4)));
+  offsets = _mm_or_si128(offsets, _mm_and_si128(plus, _mm_set1_epi8(19)));
+  offsets = _mm_or_si128(offsets, _mm_and_si128(slash, _mm_set1_epi8(16)));
+
+  const auto valid = _mm_or_si128(_mm_or_si128(upper, lower),
+      _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+  invalidMask = _mm_movemask_epi8(valid) ^ 0xFFFF;
+  return _mm_add_epi8(chars, offsets);
+}
+
+// Pack 16 values of 6 bits to 12 bytes, in the low part of the result
+BASE64_TARGET("ssse3")
+inline __m128i packValues128(__m128i values)
+{
+  // Merge pairs of values to 12 bits, then pairs of those to 24 bits
+  const auto pairs =
+      _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  const auto triplets = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  return _mm_shuffle_epi8(triplets,
+      _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+// Decode blocks of 16 characters, returns the number of characters decoded
+BASE64_TARGET("ssse3")
+size_t decodeSsse3(const char *src, size_t size, unsigned char *dst,
+    bool &isValid)
+{
+  size_t decoded = 0;
+  for (; decoded + 16 <= size; decoded += 16, dst += 12) {
+    const auto chars = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(src + decoded));
+    int invalidMask;
+    const auto values = decodeValues128(chars, invalidMask);
+    if (invalidMask) {
+      isValid = false;
+      return decoded;
+    }
+    const auto bytes = packValues128(values);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), bytes);
+    const auto last = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+    std::memcpy(dst + 8, &last, 4);
+  }
+  return decoded;
+}
+
+BASE64_TARGET("avx2")
+inline __m256i inRange256(__m256i chars, char first, char last)
+{
+  return _mm256_and_si256(
+      _mm256_cmpgt_epi8(chars, _mm256_set1_epi8(first - 1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(last + 1), chars));
+}
+
+// Decode blocks of 32 characters, returns the number of characters decoded
+BASE64_TARGET("avx2")
+size_t decodeAvx2(const char *src, size_t size, unsigned char *dst,
+    bool &isValid)
+{
+  size_t decoded = 0;
+  for (; decoded + 32 <= size; decoded += 32, dst += 24) {
+    const auto chars = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + decoded));
+    const auto upper = inRange256(chars, 'A', 'Z');
+    const auto lower = inRange256(chars, 'a', 'z');
+    const auto digit = inRange256(chars, '0', '9');
+    const auto plus = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('+'));
+    const auto slash = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('/'));
+    const auto valid = _mm256_or_si256(_mm256_or_si256(upper, lower),
+        _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+    if (_mm256_movemask_epi8(valid) != -1) {
+      isValid = false;
+      return decoded;
+    }
+
+    auto offsets = _mm256_and_si256(upper, _mm256_set1_epi8(-65));
+    offsets = _mm256_or_si256(
+        offsets, _mm256_and_si256(lower, _mm256_set1_epi8(-71)));
+    offsets = _mm256_or_si256(
+        offsets, _mm256_and_si256(digit, _mm256_set1_epi8(4)));
+    offsets = _mm256_or_si256(
+        offsets, _mm256_and_si256(plus, _mm256_set1_epi8(19)));
+    offsets = _mm256_or_si256(
+        offsets, _mm256_and_si256(slash, _mm256_set1_epi8(16)));
+    const auto values = _mm256_add_epi8(chars, offsets);
+
+    const auto pairs =
+        _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    const auto triplets =
+        _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    // 12 bytes in each 128 bits lane, then gathered to the low 24 bytes
+    const auto lanes = _mm256_shuffle_epi8(triplets,
+        _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1,
+            -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    const auto bytes = _mm256_permutevar8x32_epi32(
+        lanes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(dst), _mm256_castsi256_si128(bytes));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + 16),
+        _mm256_extracti128_si256(bytes, 1));
+  }
+  return decoded;
+}
+
+enum class Isa
+{
+  Scalar,
+  Ssse3,
+  Avx2
+};
+
+Isa detectIsa()
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  const auto maxLeaf = info[0];
+  __cpuid(info, 1);
+  const bool hasSsse3 = (info[2] & (1 << 9)) != 0;
+  const bool hasOsAvx = (info[2] & (1 << 27)) != 0 && // OSXSAVE
+                        (info[2] & (1 << 28)) != 0 && // AVX
+                        (_xgetbv(0) & 6) == 6;
+  bool hasAvx2 = false;
+  if (maxLeaf >= 7) {
+    __cpuidex(info, 7, 0);
+    hasAvx2 = hasOsAvx && (info[1] & (1 << 5)) != 0;
+  }
+  return hasAvx2 ? Isa::Avx2 : hasSsse3 ? Isa::Ssse3 : Isa::Scalar;
+#else
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return Isa::Avx2;
+  }
+  return __builtin_cpu_supports("ssse3") ? Isa::Ssse3 : Isa::Scalar;
+#endif
+}
+
+#endif // BASE64_X86
+
+} // namespace
+
+size_t base64DecodedSize(const char *src, size_t size)
+{
+  size = unpaddedSize(src, size);
+  if (size % 4 == 1) {
+    return 0;
+  }
+  return size / 4 * 3 + (size % 4 ? size % 4 - 1 : 0);
+}
+
+bool base64DecodeScalar(const char *src, size_t size, unsigned char *dst)
+{
+  size = unpaddedSize(src, size);
+  return size % 4 != 1 && decodeScalar(src, size, dst);
+}
+
+bool base64Decode(const char *src, size_t size, unsigned char *dst)
+{
+  size = unpaddedSize(src, size);
+  if (size % 4 == 1) {
+    return false;
+  }
+  size_t decoded = 0;
+#ifdef BASE64_X86
+  static const auto isa = detectIsa();
+  bool isValid = true;
+  if (isa == Isa::Avx2) {
+    decoded = decodeAvx2(src, size, dst, isValid);
+  }
+  if (isa != Isa::Scalar && isValid) {
+    decoded += decodeSsse3(
+        src + decoded, size - decoded, dst + decoded / 4 * 3, isValid);
+  }
+  if (!isValid) {
+    return false;
+  }
+#endif
+  return decodeScalar(src + decoded, size - decoded, dst + decoded / 4 * 3);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+// Base64 decoding (standard alphabet, '=' padding optional) vectorized with
+// AVX2 or SSSE3 when the CPU supports them, with a scalar fallback.
+
+// Number of bytes encoded by src, or 0 if its length cannot be valid base64
+size_t base64DecodedSize(const char *src, size_t size);
+
+// Decode src into dst, which must hold base64DecodedSize(src, size) bytes.
+// Returns false if src contains a character out of the base64 alphabet.
+bool base64Decode(const char *src, size_t size, unsigned char *dst);
+
+// Same as base64Decode() but never uses SIMD instructions, for comparison
+bool base64DecodeScalar(const char *src, size_t size, unsigned char *dst);
@@ -0,0 +1,310 @@
+#include "benchmarks.hpp"
+#include "base64.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <iomanip>
+#include <iostream>
+#include <json.hpp>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// Defined by tinygltf but not declared in its header
+namespace tinygltf
+{
+std::string base64_encode(
+    unsigned char const *bytes_to_encode, unsigned int in_len);
+std::string base64_decode(std::string const &s);
+} // namespace tinygltf
+
+namespace
+{
+
+// Best time in seconds of a few runs of f
+template <typename Function> double measure(const Function &f)
+{
+  const auto RUN_COUNT = 5;
+  auto best = std::numeric_limits<double>::max();
+  for (auto i = 0; i < RUN_COUNT; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best;
+}
+
+void printResult(const char *name, size_t byteCount, double seconds)
+{
+  std::cout << std::left << std::setw(24) << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(10) << seconds * 1000.
+            << " ms" << std::setw(10) << byteCount / seconds / (1 << 20)
+            << " MB/s" << std::endl;
+}
+
+// A single primitive with positions, normals and texture coordinates
+struct BenchmarkMesh
+{
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec2> texCoords;
+  std::vector<std::array<uint32_t, 3>> triangles;
+};
+
+// Grid of gridSize x gridSize vertices from origin along uAxis and vAxis,
+// facing along their cross product
+void addGrid(BenchmarkMesh &mesh, const glm::vec3 &origin,
+    const glm::vec3 &uAxis, const glm::vec3 &vAxis, size_t gridSize)
+{
+  const auto normal = glm::normalize(glm::cross(uAxis, vAxis));
+  const auto firstVertex = uint32_t(mesh.positions.size());
+  for (size_t j = 0; j < gridSize; ++j) {
+    for (size_t i = 0; i < gridSize; ++i) {
+      const auto u = float(i) / (gridSize - 1);
+      const auto v = float(j) / (gridSize - 1);
+      mesh.positions.emplace_back(origin + u * uAxis + v * vAxis);
+      mesh.normals.emplace_back(normal);
+      mesh.texCoords.emplace_back(u, 1 - v);
+    }
+  }
+  for (size_t j = 0; j + 1 < gridSize; ++j) {
+    for (size_t i = 0; i + 1 < gridSize; ++i) {
+      const auto v = uint32_t(firstVertex + j * gridSize + i);
+      const auto above = uint32_t(v + gridSize);
+      mesh.triangles.push_back({v, v + 1, above + 1});
+      mesh.triangles.push_back({v, above + 1, above});
+    }
+  }
+}
+
+// Sphere of ringCount rings of segmentCount quads each, facing outwards
+void addSphere(BenchmarkMesh &mesh, const glm::vec3 &center, float radius,
+    size_t ringCount, size_t segmentCount)
+{
+  const auto firstVertex = uint32_t(mesh.positions.size());
+  for (size_t j = 0; j <= ringCount; ++j) {
+    const auto v = float(j) / ringCount;
+    const auto theta = glm::pi<float>() * v;
+    for (size_t i = 0; i <= segmentCount; ++i) {
+      const auto u = float(i) / segmentCount;
+      const auto phi = 2.f * glm::pi<float>() * u;
+      const glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta),
+          -std::sin(theta) * std::sin(phi));
+      mesh.positions.emplace_back(center + radius * normal);
+      mesh.normals.emplace_back(normal);
+      mesh.texCoords.emplace_back(u, v);
+    }
+  }
+  const auto rowSize = uint32_t(segmentCount + 1);
+  for (size_t j = 0; j < ringCount; ++j) {
+    for (size_t i = 0; i < segmentCount; ++i) {
+      const auto v = uint32_t(firstVertex + j * rowSize + i);
+      const auto below = v + rowSize;
+      mesh.triangles.push_back({v, below, v + 1});
+      mesh.triangles.push_back({v + 1, below, below + 1});
+    }
+  }
+}
+
+// Write a glTF file, and its .bin buffer next to it, of a single node drawing
+// the mesh. Attributes are in separate bufferViews, as most exporters write
+// them.
+bool writeBenchmarkMesh(
+    const fs::path &path, const BenchmarkMesh &mesh, std::string &err)
+{
+  auto binPath = path;
+  binPath.replace_extension(".bin");
+  std::ofstream bin(binPath.string(), std::ios::binary);
+  if (!bin) {
+    err = "Unable to open " + binPath.string();
+    return false;
+  }
+  nlohmann::json bufferViews = nlohmann::json::array();
+  size_t byteOffset = 0;
+  const auto writeBufferView = [&](const void *data, size_t byteLength,
+                                   int target) {
+    bin.write(static_cast<const char *>(data), std::streamsize(byteLength));
+    bufferViews.push_back({{"buffer", 0}, {"byteOffset", byteOffset},
+        {"byteLength", byteLength}, {"target", target}});
+    byteOffset += byteLength;
+  };
+  const auto ARRAY_BUFFER = 34962;
+  const auto ELEMENT_ARRAY_BUFFER = 34963;
+  const auto FLOAT = 5126;
+  const auto UNSIGNED_INT = 5125;
+  writeBufferView(mesh.positions.data(),
+      mesh.positions.size() * sizeof(mesh.positions[0]), ARRAY_BUFFER);
+  writeBufferView(mesh.normals.data(),
+      mesh.normals.size() * sizeof(mesh.normals[0]), ARRAY_BUFFER);
+  writeBufferView(mesh.texCoords.data(),
+      mesh.texCoords.size() * sizeof(mesh.texCoords[0]), ARRAY_BUFFER);
+  writeBufferView(mesh.triangles.data(),
+      mesh.triangles.size() * sizeof(mesh.triangles[0]), ELEMENT_ARRAY_BUFFER);
+  bin.close();
+  if (!bin) {
+    err = "Unable to write " + binPath.string();
+    return false;
+  }
+
+  auto positionMin = glm::vec3(std::numeric_limits<float>::max());
+  auto positionMax = glm::vec3(std::numeric_limits<float>::lowest());
+  for (const auto &position : mesh.positions) {
+    positionMin = glm::min(positionMin, position);
+    positionMax = glm::max(positionMax, position);
+  }
+  const auto vertexCount = mesh.positions.size();
+  const nlohmann::json document = {{"asset", {{"version", "2.0"}}},
+      {"scene", 0}, {"scenes", {{{"nodes", {0}}}}}, {"nodes", {{{"mesh", 0}}}},
+      {"meshes",
+          {{{"primitives",
+              {{{"attributes",
+                    {{"POSITION", 0}, {"NORMAL", 1}, {"TEXCOORD_0", 2}}},
+                  {"indices", 3}}}}}}},
+      {"accessors",
+          {{{"bufferView", 0}, {"componentType", FLOAT},
+               {"count", vertexCount}, {"type", "VEC3"},
+               {"min", {positionMin.x, positionMin.y, positionMin.z}},
+               {"max", {positionMax.x, positionMax.y, positionMax.z}}},
+              {{"bufferView", 1}, {"componentType", FLOAT},
+                  {"count", vertexCount}, {"type", "VEC3"}},
+              {{"bufferView", 2}, {"componentType", FLOAT},
+                  {"count", vertexCount}, {"type", "VEC2"}},
+              {{"bufferView", 3}, {"componentType", UNSIGNED_INT},
+                  {"count", 3 * mesh.triangles.size()},
+                  {"type", "SCALAR"}}}},
+      {"bufferViews", bufferViews},
+      {"buffers", {{{"uri", binPath.filename().string()},
+                      {"byteLength", byteOffset}}}}};
+  std::ofstream gltf(path.string());
+  gltf << document.dump(2) << std::endl;
+  if (!gltf) {
+    err = "Unable to write " + path.string();
+    return false;
+  }
+  std::cout << "Wrote " << path << ", " << vertexCount << " vertices, "
+            << mesh.triangles.size() << " triangles" << std::endl;
+  return true;
+}
+
+} // namespace
+
+bool benchmarkBase64Decoding(size_t byteCount)
+{
+  std::vector<unsigned char> payload(byteCount);
+  std::mt19937 generator;
+  for (auto &byte : payload) {
+    byte = static_cast<unsigned char>(generator());
+  }
+  const auto encoded =
+      tinygltf::base64_encode(payload.data(), unsigned(payload.size()));
+  std::cout << "Decoding " << encoded.size() << " base64 characters to "
+            << byteCount << " bytes" << std::endl;
+
+  auto isValid = true;
+  const auto check = [&](const char *name, const unsigned char *decoded) {
+    if (std::memcmp(decoded, payload.data(), byteCount) != 0) {
+      std::cerr << name << " gave a wrong result" << std::endl;
+      isValid = false;
+    }
+  };
+
+  std::string tinygltfDecoded;
+  printResult("tinygltf", byteCount,
+      measure([&]() { tinygltfDecoded = tinygltf::base64_decode(encoded); }));
+  check("tinygltf",
+      reinterpret_cast<const unsigned char *>(tinygltfDecoded.data()));
+
+  std::vector<unsigned char> decoded(
+      base64DecodedSize(encoded.data(), encoded.size()));
+  if (decoded.size() != byteCount) {
+    std::cerr << "base64DecodedSize() gave a wrong size" << std::endl;
+    return false;
+  }
+  printResult("scalar", byteCount, measure([&]() {
+    base64DecodeScalar(encoded.data(), encoded.size(), decoded.data());
+  }));
+  check("scalar", decoded.data());
+
+  std::fill(begin(decoded), end(decoded), 0);
+  printResult("simd", byteCount, measure([&]() {
+    base64Decode(encoded.data(), encoded.size(), decoded.data());
+  }));
+  check("simd", decoded.data());
+
+  return isValid;
+}
+
+bool writeVertexBenchmarkScene(
+    const fs::path &path, size_t gridSize, std::string &err)
+{
+  if (gridSize < 2 || gridSize > (1 << 15)) {
+    err = "Grid size must be in [2, 32768]";
+    return false;
+  }
+  // The viewer looks down -z from the origin by default
+  const auto GRID_DEPTH = -2.f;
+  BenchmarkMesh mesh;
+  addGrid(mesh, glm::vec3(-1.f, -1.f, GRID_DEPTH), glm::vec3(2.f, 0.f, 0.f),
+      glm::vec3(0.f, 2.f, 0.f), gridSize);
+  // Random order defeats the post-transform cache and the locality of
+  // vertex fetches, that the import stages may then restore
+  std::mt19937 generator;
+  std::shuffle(begin(mesh.triangles), end(mesh.triangles), generator);
+  return writeBenchmarkMesh(path, mesh, err);
+}
+
+bool writeOverdrawBenchmarkScene(
+    const fs::path &path, size_t objectCount, std::string &err)
+{
+  if (objectCount > (1 << 16)) {
+    err = "Object count must be at most 65536";
+    return false;
+  }
+  // The viewer looks down -z from the origin by default, from the center of
+  // the room
+  const auto ROOM_HALF_SIZE = 4.f;
+  const size_t WALL_GRID_SIZE = 64;
+  const size_t SPHERE_RING_COUNT = 16;
+  const size_t SPHERE_SEGMENT_COUNT = 32;
+  BenchmarkMesh mesh;
+  // Walls face the inside of the room
+  const auto s = ROOM_HALF_SIZE;
+  const auto side = 2.f * s;
+  const glm::vec3 walls[][3] = {
+      {{-s, -s, -s}, {side, 0.f, 0.f}, {0.f, side, 0.f}},
+      {{s, -s, s}, {-side, 0.f, 0.f}, {0.f, side, 0.f}},
+      {{-s, -s, s}, {0.f, 0.f, -side}, {0.f, side, 0.f}},
+      {{s, -s, -s}, {0.f, 0.f, side}, {0.f, side, 0.f}},
+      {{-s, -s, s}, {side, 0.f, 0.f}, {0.f, 0.f, -side}},
+      {{-s, s, -s}, {side, 0.f, 0.f}, {0.f, 0.f, side}}};
+  for (const auto &wall : walls) {
+    addGrid(mesh, wall[0], wall[1], wall[2], WALL_GRID_SIZE);
+  }
+
+  // Furniture in front of the camera, drawn from back to front after the
+  // walls: the worst order for overdraw, that exporters often produce
+  std::mt19937 generator;
+  std::uniform_real_distribution<float> lateral(-0.75f * s, 0.75f * s);
+  std::uniform_real_distribution<float> depth(-0.9f * s, -0.25f * s);
+  std::uniform_real_distribution<float> radius(0.05f * s, 0.15f * s);
+  std::vector<glm::vec4> spheres(objectCount);
+  for (auto &sphere : spheres) {
+    sphere = glm::vec4(lateral(generator), lateral(generator),
+        depth(generator), radius(generator));
+  }
+  std::sort(begin(spheres), end(spheres),
+      [](const glm::vec4 &lhs, const glm::vec4 &rhs) { return lhs.z < rhs.z; });
+  for (const auto &sphere : spheres) {
+    addSphere(mesh, glm::vec3(sphere), sphere.w, SPHERE_RING_COUNT,
+        SPHERE_SEGMENT_COUNT);
+  }
+  return writeBenchmarkMesh(path, mesh, err);
+}
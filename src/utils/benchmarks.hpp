@@ -0,0 +1,28 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstddef>
+#include <string>
+
+// Microbenchmarks run from the command line, results are printed to stdout
+
+// Compare tinygltf base64 decoding to ours on a random payload of byteCount
+// bytes. Returns false if a decoder gives a wrong result.
+bool benchmarkBase64Decoding(size_t byteCount);
+
+// Write a glTF file, and its .bin buffer next to it, of a grid of gridSize x
+// gridSize vertices in front of the default camera of the viewer. Triangles
+// are shuffled and cover about a pixel each, so that drawing the grid is bound
+// by vertex fetching and processing. Attributes are in separate bufferViews,
+// as most exporters write them.
+bool writeVertexBenchmarkScene(
+    const fs::path &path, size_t gridSize, std::string &err);
+
+// Write a glTF file, and its .bin buffer next to it, of a room around the
+// default camera of the viewer, with objectCount spheres in front of it.
+// Walls and then spheres are drawn from back to front, so that with a costly
+// fragment shader such as lights.fs.glsl drawing the room is bound by
+// overdraw.
+bool writeOverdrawBenchmarkScene(
+    const fs::path &path, size_t objectCount, std::string &err);
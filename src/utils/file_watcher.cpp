@@ -0,0 +1,143 @@
+#include "file_watcher.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// Same path for a file whatever the way it is referred to, so that paths can
+// be compared. Only the directory is made canonical, the file may be replaced.
+fs::path normalizePath(const std::string &path)
+{
+  const auto absolutePath = fs::absolute(fs::path(path));
+  std::error_code error;
+  const auto directory = fs::canonical(absolutePath.parent_path(), error);
+  return error ? absolutePath : directory / absolutePath.filename();
+}
+
+} // namespace
+
+FileWatcher::FileWatcher(const std::vector<std::string> &paths)
+{
+  for (const auto &path : paths) {
+    m_paths.emplace_back(normalizePath(path));
+  }
+#ifdef __linux__
+  m_nFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_nFd < 0) {
+    throw std::runtime_error("Unable to initialize inotify");
+  }
+  for (const auto &path : m_paths) {
+    const auto directory = path.parent_path();
+    if (std::find(begin(m_directories), end(m_directories), directory) !=
+        end(m_directories)) {
+      continue;
+    }
+    const auto wd = inotify_add_watch(m_nFd, directory.string().c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    if (wd < 0) {
+      release();
+      throw std::runtime_error(
+          "Unable to watch directory " + directory.string());
+    }
+    m_watchDescriptors.emplace_back(wd);
+    m_directories.emplace_back(directory);
+  }
+#else
+  for (const auto &path : m_paths) {
+    std::error_code error;
+    m_writeTimes.emplace_back(fs::last_write_time(path, error));
+  }
+#endif
+}
+
+FileWatcher::~FileWatcher() { release(); }
+
+FileWatcher::FileWatcher(FileWatcher &&rvalue) noexcept :
+    m_paths(std::move(rvalue.m_paths)),
+#ifdef __linux__
+    m_nFd(rvalue.m_nFd),
+    m_watchDescriptors(std::move(rvalue.m_watchDescriptors)),
+    m_directories(std::move(rvalue.m_directories))
+#else
+    m_writeTimes(std::move(rvalue.m_writeTimes))
+#endif
+{
+#ifdef __linux__
+  rvalue.m_nFd = -1;
+#endif
+}
+
+FileWatcher &FileWatcher::operator=(FileWatcher &&rvalue) noexcept
+{
+  if (this != &rvalue) {
+    release();
+    m_paths = std::move(rvalue.m_paths);
+#ifdef __linux__
+    m_nFd = rvalue.m_nFd;
+    m_watchDescriptors = std::move(rvalue.m_watchDescriptors);
+    m_directories = std::move(rvalue.m_directories);
+    rvalue.m_nFd = -1;
+#else
+    m_writeTimes = std::move(rvalue.m_writeTimes);
+#endif
+  }
+  return *this;
+}
+
+bool FileWatcher::hasChanged()
+{
+  auto hasChanged = false;
+#ifdef __linux__
+  if (m_nFd < 0) {
+    return false;
+  }
+  alignas(inotify_event) char events[4096];
+  ssize_t size;
+  while ((size = read(m_nFd, events, sizeof(events))) > 0) {
+    for (auto p = events; p < events + size;) {
+      const auto &event = *reinterpret_cast<const inotify_event *>(p);
+      p += sizeof(inotify_event) + event.len;
+      const auto it = std::find(
+          begin(m_watchDescriptors), end(m_watchDescriptors), event.wd);
+      if (it == end(m_watchDescriptors) || event.len == 0) {
+        continue;
+      }
+      const auto path =
+          m_directories[it - begin(m_watchDescriptors)] / event.name;
+      if (std::find(begin(m_paths), end(m_paths), path) != end(m_paths)) {
+        hasChanged = true;
+      }
+    }
+  }
+#else
+  for (size_t i = 0; i < m_paths.size(); ++i) {
+    std::error_code error;
+    const auto writeTime = fs::last_write_time(m_paths[i], error);
+    if (writeTime != m_writeTimes[i]) {
+      m_writeTimes[i] = writeTime;
+      hasChanged = true;
+    }
+  }
+#endif
+  return hasChanged;
+}
+
+void FileWatcher::release()
+{
+#ifdef __linux__
+  if (m_nFd >= 0) {
+    close(m_nFd); // Also removes the watches
+  }
+  m_nFd = -1;
+  m_watchDescriptors.clear();
+  m_directories.clear();
+#endif
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <string>
+#include <vector>
+
+// Detect changes of a set of files, without blocking. Uses inotify on Linux,
+// and compares modification times on other platforms. Directories of the
+// files are watched rather than the files themselves, so that files replaced
+// by a rename (as many editors and exporters do) are still watched.
+class FileWatcher
+{
+  std::vector<fs::path> m_paths;
+#ifdef __linux__
+  int m_nFd = -1; // inotify instance
+  std::vector<int> m_watchDescriptors; // One per directory
+  std::vector<fs::path> m_directories; // Indexed like m_watchDescriptors
+#else
+  std::vector<fs::file_time_type> m_writeTimes; // Indexed like m_paths
+#endif
+
+public:
+  FileWatcher() = default;
+
+  // Throws std::runtime_error if the files cannot be watched
+  explicit FileWatcher(const std::vector<std::string> &paths);
+
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher &) = delete;
+
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  FileWatcher(FileWatcher &&rvalue) noexcept;
+
+  FileWatcher &operator=(FileWatcher &&rvalue) noexcept;
+
+  // True if a watched file was written, created, replaced or removed since
+  // the last call
+  bool hasChanged();
+
+private:
+  void release();
+};
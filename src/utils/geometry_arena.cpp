@@ -0,0 +1,978 @@
+#include "geometry_arena.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+
+const char *getVertexAttribName(int attrib)
+{
+  static const char *NAMES[VERTEX_ATTRIB_COUNT] = {
+      "POSITION", "NORMAL", "TEXCOORD_0"};
+  return NAMES[attrib];
+}
+
+int getVertexAttribComponentCount(int attrib)
+{
+  static const int COMPONENT_COUNTS[VERTEX_ATTRIB_COUNT] = {3, 3, 2};
+  return COMPONENT_COUNTS[attrib];
+}
+
+VertexAttribFormat getVertexAttribFormat(
+    const VertexFormat &format, int attrib)
+{
+  if (!format.isQuantized) {
+    const auto componentCount = getVertexAttribComponentCount(attrib);
+    return {componentCount, GL_FLOAT, GL_FALSE, componentCount * sizeof(float)};
+  }
+  switch (attrib) {
+  case VERTEX_ATTRIB_POSITION:
+    // The fourth component, unused, keeps attributes 4 bytes aligned
+    return {4, GL_SHORT, GL_TRUE, 4 * sizeof(int16_t)};
+  case VERTEX_ATTRIB_NORMAL:
+    return {2, GL_SHORT, GL_TRUE, 2 * sizeof(int16_t)};
+  }
+  return {2, GL_HALF_FLOAT, GL_FALSE, 2 * sizeof(uint16_t)};
+}
+
+size_t getVertexAttribStride(const VertexFormat &format, int attrib)
+{
+  return format.isInterleaved
+             ? getVertexAttribOffset(format, VERTEX_ATTRIB_COUNT, 1)
+             : getVertexAttribFormat(format, attrib).byteSize;
+}
+
+size_t getVertexAttribOffset(
+    const VertexFormat &format, int attrib, size_t vertexCapacity)
+{
+  size_t offset = 0;
+  for (int i = 0; i < attrib; ++i) {
+    offset += getVertexAttribFormat(format, i).byteSize;
+  }
+  // Interleaved, the offset is the one of the attribute in a vertex
+  return format.isInterleaved ? offset : offset * vertexCapacity;
+}
+
+size_t getArenaVertexBufferSize(
+    const VertexFormat &format, size_t vertexCapacity)
+{
+  return getVertexAttribOffset(format, VERTEX_ATTRIB_COUNT, 1) *
+         vertexCapacity;
+}
+
+RangeAllocator::RangeAllocator(size_t capacity) : m_capacity(capacity)
+{
+  if (capacity > 0) {
+    m_freeRanges[0] = capacity;
+  }
+}
+
+bool RangeAllocator::allocate(size_t count, size_t &first)
+{
+  if (count == 0) {
+    first = 0;
+    return true;
+  }
+  for (auto it = begin(m_freeRanges); it != end(m_freeRanges); ++it) {
+    if (it->second >= count) {
+      first = it->first;
+      const auto remainingCount = it->second - count;
+      m_freeRanges.erase(it);
+      if (remainingCount > 0) {
+        m_freeRanges[first + count] = remainingCount;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void RangeAllocator::free(size_t first, size_t count)
+{
+  if (count == 0) {
+    return;
+  }
+  auto last = first + count;
+  // Merge with the free ranges right after and right before
+  auto next = m_freeRanges.lower_bound(first);
+  assert(next == end(m_freeRanges) || last <= next->first);
+  if (next != end(m_freeRanges) && next->first == last) {
+    last += next->second;
+    next = m_freeRanges.erase(next);
+  }
+  if (next != begin(m_freeRanges)) {
+    const auto previous = std::prev(next);
+    assert(previous->first + previous->second <= first);
+    if (previous->first + previous->second == first) {
+      previous->second = last - previous->first;
+      return;
+    }
+  }
+  m_freeRanges.emplace_hint(next, first, last - first);
+}
+
+size_t getElementByteSize(const tinygltf::Accessor &accessor)
+{
+  return size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType)) *
+         size_t(tinygltf::GetNumComponentsInType(accessor.type));
+}
+
+bool isAccessorReadable(const tinygltf::Model &model,
+    const GltfBuffers &buffers, int accessorIdx)
+{
+  if (accessorIdx < 0 || size_t(accessorIdx) >= model.accessors.size()) {
+    return false;
+  }
+  const auto &accessor = model.accessors[accessorIdx];
+  if (tinygltf::GetComponentSizeInBytes(accessor.componentType) <= 0 ||
+      tinygltf::GetNumComponentsInType(accessor.type) <= 0) {
+    return false;
+  }
+  if (accessor.bufferView < 0) {
+    return true;
+  }
+  if (size_t(accessor.bufferView) >= model.bufferViews.size()) {
+    return false;
+  }
+  if (accessor.count == 0) {
+    return true;
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  const auto byteStride = accessor.ByteStride(bufferView);
+  if (bufferView.buffer < 0 ||
+      size_t(bufferView.buffer) >= buffers.bytes.size() || byteStride <= 0) {
+    return false;
+  }
+  const auto byteLength = accessor.byteOffset +
+                          size_t(byteStride) * (accessor.count - 1) +
+                          getElementByteSize(accessor);
+  return byteLength <= bufferView.byteLength &&
+         bufferView.byteOffset + bufferView.byteLength <=
+             buffers.bytes[bufferView.buffer].size;
+}
+
+namespace
+{
+
+// Hash of what an accessor reads: its content if bufferViewHashes is not
+// empty, its bufferView index otherwise
+uint64_t hashAccessor(const tinygltf::Model &model, int accessorIdx,
+    const std::vector<uint64_t> &bufferViewHashes, uint64_t seed)
+{
+  if (accessorIdx < 0) {
+    return hash64(&accessorIdx, sizeof(accessorIdx), seed);
+  }
+  const auto &accessor = model.accessors[accessorIdx];
+  uint64_t bufferViewKey = uint64_t(accessor.bufferView);
+  uint64_t byteStride = 0;
+  if (accessor.bufferView >= 0 &&
+      size_t(accessor.bufferView) < model.bufferViews.size()) {
+    byteStride =
+        uint64_t(accessor.ByteStride(model.bufferViews[accessor.bufferView]));
+    if (!bufferViewHashes.empty()) {
+      bufferViewKey = bufferViewHashes[accessor.bufferView];
+    }
+  }
+  const uint64_t values[] = {uint64_t(accessor.componentType),
+      uint64_t(accessor.type), uint64_t(accessor.normalized),
+      uint64_t(accessor.count), uint64_t(accessor.byteOffset), byteStride,
+      bufferViewKey};
+  return hash64(values, sizeof(values), seed);
+}
+
+float readComponent(const unsigned char *data, int componentType,
+    bool isNormalized)
+{
+  // Normalized integers are converted as described by the glTF specification
+  const auto read = [data](auto value) {
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  };
+  switch (componentType) {
+  case TINYGLTF_COMPONENT_TYPE_BYTE:
+    return isNormalized ? std::max(read(int8_t()) / 127.f, -1.f)
+                        : float(read(int8_t()));
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return isNormalized ? read(uint8_t()) / 255.f : float(read(uint8_t()));
+  case TINYGLTF_COMPONENT_TYPE_SHORT:
+    return isNormalized ? std::max(read(int16_t()) / 32767.f, -1.f)
+                        : float(read(int16_t()));
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    return isNormalized ? read(uint16_t()) / 65535.f
+                        : float(read(uint16_t()));
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    return float(read(uint32_t()));
+  case TINYGLTF_COMPONENT_TYPE_FLOAT:
+    return read(float());
+  }
+  return 0.f;
+}
+
+// Bounds of the positions of an accessor, from its min and max if it has them
+void computePositionBounds(const tinygltf::Model &model,
+    const GltfBuffers &buffers, int accessorIdx, glm::vec3 &min,
+    glm::vec3 &max)
+{
+  const auto &accessor = model.accessors[accessorIdx];
+  if (accessor.minValues.size() == 3 && accessor.maxValues.size() == 3) {
+    min = glm::vec3(accessor.minValues[0], accessor.minValues[1],
+        accessor.minValues[2]);
+    max = glm::vec3(accessor.maxValues[0], accessor.maxValues[1],
+        accessor.maxValues[2]);
+    return;
+  }
+  // They are required by glTF, but some exporters omit them
+  min = glm::vec3(std::numeric_limits<float>::max());
+  max = glm::vec3(std::numeric_limits<float>::lowest());
+  const size_t BATCH_SIZE = 4096;
+  std::vector<glm::vec3> positions(BATCH_SIZE);
+  for (size_t first = 0; first < accessor.count; first += BATCH_SIZE) {
+    const auto count = std::min(BATCH_SIZE, accessor.count - first);
+    readVertexAttrib(model, buffers, accessorIdx, 3, first, count,
+        &positions[0].x, 3);
+    for (size_t i = 0; i < count; ++i) {
+      min = glm::min(min, positions[i]);
+      max = glm::max(max, positions[i]);
+    }
+  }
+  if (accessor.count == 0) {
+    min = max = glm::vec3(0.f);
+  }
+}
+
+// Quantized positions are in [-1, 1] around the center of their bounds
+glm::vec3 getPositionCenter(const ArenaBlock &vertexBlock)
+{
+  return 0.5f * (vertexBlock.positionMin + vertexBlock.positionMax);
+}
+
+glm::vec3 getPositionHalfExtent(const ArenaBlock &vertexBlock)
+{
+  return 0.5f * (vertexBlock.positionMax - vertexBlock.positionMin);
+}
+
+int16_t quantizeSnorm16(float value)
+{
+  return int16_t(std::round(glm::clamp(value, -1.f, 1.f) * 32767.f));
+}
+
+// Octahedral coordinates in [-1, 1]^2 of a unit vector
+glm::vec2 encodeOctahedral(const glm::vec3 &normal)
+{
+  const auto l1Norm =
+      std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  if (l1Norm == 0.f) {
+    return glm::vec2(0.f);
+  }
+  auto coords = glm::vec2(normal) / l1Norm;
+  if (normal.z < 0.f) {
+    // Lower hemisphere, folded over the diagonals
+    coords = (1.f - glm::abs(glm::vec2(coords.y, coords.x))) *
+             glm::vec2(coords.x >= 0.f ? 1.f : -1.f,
+                 coords.y >= 0.f ? 1.f : -1.f);
+  }
+  return coords;
+}
+
+int findOrAddBlock(std::vector<ArenaBlock> &blocks,
+    std::unordered_map<uint64_t, int> &blockIndices, const ArenaBlock &block)
+{
+  const auto it = blockIndices.find(block.key);
+  if (it != end(blockIndices)) {
+    return it->second;
+  }
+  const auto blockIdx = int(blocks.size());
+  blocks.emplace_back(block);
+  blockIndices[block.key] = blockIdx;
+  return blockIdx;
+}
+
+void reuseBlocks(const std::vector<ArenaBlock> &previousBlocks,
+    bool canReuse, std::vector<ArenaBlock> &blocks, RangeAllocator &allocator)
+{
+  std::unordered_map<uint64_t, size_t> blockIndices;
+  if (canReuse) {
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      blockIndices[blocks[i].key] = i;
+    }
+  }
+  for (const auto &previousBlock : previousBlocks) {
+    if (!previousBlock.isAllocated) {
+      continue;
+    }
+    const auto it = blockIndices.find(previousBlock.key);
+    if (previousBlock.isUploaded && it != end(blockIndices) &&
+        !blocks[it->second].isAllocated) {
+      auto &block = blocks[it->second];
+      block.first = previousBlock.first;
+      block.isAllocated = true;
+      block.isUploaded = true;
+    } else {
+      allocator.free(
+          previousBlock.first, getArenaBlockUnitCount(previousBlock));
+    }
+  }
+}
+
+bool allocateBlocks(std::vector<ArenaBlock> &blocks, RangeAllocator &allocator)
+{
+  for (auto &block : blocks) {
+    if (!block.isAllocated) {
+      if (!allocator.allocate(getArenaBlockUnitCount(block), block.first)) {
+        return false;
+      }
+      block.isAllocated = true;
+    }
+  }
+  return true;
+}
+
+size_t getBlockUnitCount(const std::vector<ArenaBlock> &blocks)
+{
+  size_t count = 0;
+  for (const auto &block : blocks) {
+    count += getArenaBlockUnitCount(block);
+  }
+  return count;
+}
+
+// Range of the indices of a block, and the size they are narrowed to
+void computeIndexRange(const tinygltf::Model &model,
+    const GltfBuffers &buffers, ArenaBlock &indexBlock)
+{
+  // Accessors min and max are optional for indices, and not trusted since
+  // wrong ones would make narrowed indices wrap
+  auto minIndex = std::numeric_limits<uint32_t>::max();
+  auto maxIndex = uint32_t(0);
+  const size_t BATCH_SIZE = 4096;
+  uint32_t indices[BATCH_SIZE];
+  for (size_t first = 0; first < indexBlock.count; first += BATCH_SIZE) {
+    const auto count = std::min(BATCH_SIZE, indexBlock.count - first);
+    readIndices(
+        model, buffers, indexBlock.indexAccessor, first, count, indices);
+    for (size_t i = 0; i < count; ++i) {
+      minIndex = std::min(minIndex, indices[i]);
+      maxIndex = std::max(maxIndex, indices[i]);
+    }
+  }
+  if (indexBlock.count == 0) {
+    minIndex = 0;
+  }
+  indexBlock.minIndex = minIndex;
+  indexBlock.maxIndex = maxIndex;
+  const auto range = maxIndex - minIndex;
+  indexBlock.indexByteSize = range <= std::numeric_limits<uint8_t>::max()
+                                 ? sizeof(uint8_t)
+                                 : range <= std::numeric_limits<uint16_t>::max()
+                                       ? sizeof(uint16_t)
+                                       : sizeof(uint32_t);
+}
+
+template <typename Index>
+void narrowIndices(const uint32_t *indices, size_t count, uint32_t minIndex,
+    unsigned char *dst)
+{
+  for (size_t i = 0; i < count; ++i) {
+    const auto index = Index(indices[i] - minIndex);
+    std::memcpy(dst + i * sizeof(Index), &index, sizeof(Index));
+  }
+}
+
+// Levels of detail of a primitive, with the accessor of their indices in
+// indexBlock. Levels are read up to the first missing or invalid one.
+void readLods(const tinygltf::Model &model, const GltfBuffers &buffers,
+    const tinygltf::Primitive &primitive, std::vector<ArenaLod> &lods)
+{
+  lods.clear();
+  const auto errorsIt = primitive.attributes.find(LOD_ERRORS_ATTRIBUTE);
+  if (errorsIt == end(primitive.attributes) ||
+      !isAccessorReadable(model, buffers, errorsIt->second)) {
+    return;
+  }
+  const auto &errorsAccessor = model.accessors[errorsIt->second];
+  if (errorsAccessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT ||
+      errorsAccessor.type != TINYGLTF_TYPE_SCALAR) {
+    return;
+  }
+  const auto lodCount = std::min(errorsAccessor.count, MAX_LOD_COUNT);
+  std::vector<float> errors(lodCount);
+  readVertexAttrib(
+      model, buffers, errorsIt->second, 1, 0, lodCount, errors.data(), 1);
+  for (size_t i = 0; i < lodCount; ++i) {
+    const auto it = primitive.attributes.find(
+        LOD_INDICES_ATTRIBUTE + std::to_string(i + 1));
+    if (it == end(primitive.attributes) ||
+        !isIndicesReadable(model, buffers, it->second)) {
+      return;
+    }
+    ArenaLod lod;
+    lod.indexBlock = it->second;
+    lod.error = errors[i];
+    lods.emplace_back(lod);
+  }
+}
+
+} // namespace
+
+bool isVertexAttribReadable(const tinygltf::Model &model,
+    const GltfBuffers &buffers, int accessorIdx, int attrib)
+{
+  return isAccessorReadable(model, buffers, accessorIdx) &&
+         tinygltf::GetNumComponentsInType(model.accessors[accessorIdx].type) ==
+             getVertexAttribComponentCount(attrib);
+}
+
+bool isIndicesReadable(
+    const tinygltf::Model &model, const GltfBuffers &buffers, int accessorIdx)
+{
+  if (!isAccessorReadable(model, buffers, accessorIdx)) {
+    return false;
+  }
+  const auto &accessor = model.accessors[accessorIdx];
+  return accessor.type == TINYGLTF_TYPE_SCALAR &&
+         (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE ||
+             accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ||
+             accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT);
+}
+
+GeometryLayout computeGeometryLayout(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const std::vector<uint64_t> &bufferViewHashes)
+{
+  GeometryLayout layout;
+  layout.hasContentKeys = !bufferViewHashes.empty();
+  std::unordered_map<uint64_t, int> vertexBlockIndices;
+  std::unordered_map<uint64_t, int> indexBlockIndices;
+  const auto addIndexBlock = [&](int accessorIdx) {
+    ArenaBlock indexBlock;
+    indexBlock.indexAccessor = accessorIdx;
+    indexBlock.count = model.accessors[accessorIdx].count;
+    indexBlock.key = hashAccessor(model, accessorIdx, bufferViewHashes, 0);
+    return findOrAddBlock(layout.indexBlocks, indexBlockIndices, indexBlock);
+  };
+  for (const auto &mesh : model.meshes) {
+    layout.meshFirstPrimitives.emplace_back(layout.primitives.size());
+    for (const auto &primitive : mesh.primitives) {
+      ArenaPrimitive arenaPrimitive;
+      arenaPrimitive.mode = primitive.mode;
+
+      // Vertices are counted by POSITION, other attributes must match
+      ArenaBlock vertexBlock;
+      for (int attrib = 0; attrib < VERTEX_ATTRIB_COUNT; ++attrib) {
+        const auto it = primitive.attributes.find(getVertexAttribName(attrib));
+        if (it == end(primitive.attributes) ||
+            !isVertexAttribReadable(model, buffers, it->second, attrib)) {
+          continue;
+        }
+        const auto count = model.accessors[it->second].count;
+        if (attrib == VERTEX_ATTRIB_POSITION || count == vertexBlock.count) {
+          vertexBlock.attribAccessors[attrib] = it->second;
+          vertexBlock.count = count;
+        }
+      }
+      if (vertexBlock.attribAccessors[VERTEX_ATTRIB_POSITION] >= 0) {
+        computePositionBounds(model, buffers,
+            vertexBlock.attribAccessors[VERTEX_ATTRIB_POSITION],
+            vertexBlock.positionMin, vertexBlock.positionMax);
+        for (const auto accessorIdx : vertexBlock.attribAccessors) {
+          vertexBlock.key = hashAccessor(
+              model, accessorIdx, bufferViewHashes, vertexBlock.key);
+        }
+        // Quantized positions depend on the bounds, that a reloaded file may
+        // change without changing the positions
+        for (const auto &bound :
+            {vertexBlock.positionMin, vertexBlock.positionMax}) {
+          vertexBlock.key = hash64(&bound, sizeof(bound), vertexBlock.key);
+        }
+        arenaPrimitive.vertexBlock = findOrAddBlock(
+            layout.vertexBlocks, vertexBlockIndices, vertexBlock);
+      }
+
+      if (primitive.indices >= 0 && arenaPrimitive.vertexBlock >= 0) {
+        if (isIndicesReadable(model, buffers, primitive.indices)) {
+          arenaPrimitive.indexBlock = addIndexBlock(primitive.indices);
+          const auto indexCount = model.accessors[primitive.indices].count;
+          if (readMeshlets(
+                  model, buffers, primitive, arenaPrimitive.meshlets)) {
+            for (const auto &meshlet : arenaPrimitive.meshlets) {
+              if (meshlet.firstIndex + 3 * size_t(meshlet.triangleCount) >
+                  indexCount) {
+                arenaPrimitive.meshlets.clear();
+                break;
+              }
+            }
+          }
+          readLods(model, buffers, primitive, arenaPrimitive.lods);
+          for (auto &lod : arenaPrimitive.lods) {
+            lod.indexBlock = addIndexBlock(lod.indexBlock);
+          }
+        } else {
+          arenaPrimitive.vertexBlock = -1; // Would draw wrong triangles
+        }
+      }
+      layout.primitives.emplace_back(arenaPrimitive);
+    }
+  }
+  parallelFor(layout.indexBlocks.size(), [&](size_t i) {
+    computeIndexRange(model, buffers, layout.indexBlocks[i]);
+  });
+  // Levels of detail must draw the vertices of their primitive
+  for (auto &primitive : layout.primitives) {
+    for (size_t i = 0; i < primitive.lods.size(); ++i) {
+      const auto &lodBlock = layout.indexBlocks[primitive.lods[i].indexBlock];
+      if (lodBlock.maxIndex >=
+          layout.vertexBlocks[primitive.vertexBlock].count) {
+        primitive.lods.resize(i);
+        break;
+      }
+    }
+  }
+  return layout;
+}
+
+bool isVertexAttribute(const std::string &name)
+{
+  return name != MESHLET_RANGES_ATTRIBUTE &&
+         name != MESHLET_SPHERES_ATTRIBUTE &&
+         name != MESHLET_CONES_ATTRIBUTE && name != LOD_ERRORS_ATTRIBUTE &&
+         name.compare(0, sizeof(LOD_INDICES_ATTRIBUTE) - 1,
+             LOD_INDICES_ATTRIBUTE) != 0;
+}
+
+bool readMeshlets(const tinygltf::Model &model, const GltfBuffers &buffers,
+    const tinygltf::Primitive &primitive, std::vector<Meshlet> &meshlets)
+{
+  meshlets.clear();
+  // Type and offset in Meshlet of each attribute, which holds consecutive
+  // members
+  const struct
+  {
+    const char *name;
+    int componentType;
+    int type;
+    size_t memberOffset;
+  } attributes[] = {
+      {MESHLET_RANGES_ATTRIBUTE, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT,
+          TINYGLTF_TYPE_VEC2, offsetof(Meshlet, firstIndex)},
+      {MESHLET_SPHERES_ATTRIBUTE, TINYGLTF_COMPONENT_TYPE_FLOAT,
+          TINYGLTF_TYPE_VEC4, offsetof(Meshlet, center)},
+      {MESHLET_CONES_ATTRIBUTE, TINYGLTF_COMPONENT_TYPE_FLOAT,
+          TINYGLTF_TYPE_VEC4, offsetof(Meshlet, coneAxis)}};
+  int accessors[3];
+  for (size_t i = 0; i < 3; ++i) {
+    const auto it = primitive.attributes.find(attributes[i].name);
+    if (it == end(primitive.attributes) ||
+        !isAccessorReadable(model, buffers, it->second)) {
+      return false;
+    }
+    const auto &accessor = model.accessors[it->second];
+    if (accessor.componentType != attributes[i].componentType ||
+        accessor.type != attributes[i].type || accessor.bufferView < 0 ||
+        (i > 0 && accessor.count != model.accessors[accessors[0]].count)) {
+      return false;
+    }
+    accessors[i] = it->second;
+  }
+  const auto count = model.accessors[accessors[0]].count;
+  meshlets.resize(count);
+  for (size_t i = 0; i < 3; ++i) {
+    const auto &accessor = model.accessors[accessors[i]];
+    const auto bytes =
+        getAccessorBytes(model, buffers, accessors[i], 0, count);
+    const auto byteStride =
+        size_t(accessor.ByteStride(model.bufferViews[accessor.bufferView]));
+    const auto elementByteSize = getElementByteSize(accessor);
+    for (size_t m = 0; m < count; ++m) {
+      std::memcpy(reinterpret_cast<unsigned char *>(&meshlets[m]) +
+                      attributes[i].memberOffset,
+          bytes.data + m * byteStride, elementByteSize);
+    }
+  }
+  return !meshlets.empty();
+}
+
+void cullMeshlets(const std::vector<Meshlet> &meshlets,
+    const glm::mat4 &modelViewProjMatrix, const glm::vec3 &cameraPosition,
+    std::vector<uint32_t> &firstIndices, std::vector<GLsizei> &indexCounts)
+{
+  firstIndices.clear();
+  indexCounts.clear();
+  // Planes of the view frustum in the space of the positions, from the rows
+  // of the matrix, pointing inwards and normalized so that they give
+  // distances (Gribb and Hartmann)
+  glm::vec4 planes[6];
+  const auto transposed = glm::transpose(modelViewProjMatrix);
+  for (int i = 0; i < 3; ++i) {
+    planes[2 * i] = transposed[3] + transposed[i];
+    planes[2 * i + 1] = transposed[3] - transposed[i];
+  }
+  for (auto &plane : planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  for (const auto &meshlet : meshlets) {
+    auto isVisible = true;
+    for (const auto &plane : planes) {
+      if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w <
+          -meshlet.radius) {
+        isVisible = false;
+        break;
+      }
+    }
+    // Every triangle faces away if every point of the bounding sphere is in
+    // the cone of directions from the camera where they all do
+    const auto toCenter = meshlet.center - cameraPosition;
+    if (!isVisible || glm::dot(toCenter, meshlet.coneAxis) >
+                          meshlet.coneCutoff * glm::length(toCenter) +
+                              meshlet.radius) {
+      continue;
+    }
+    const auto indexCount = GLsizei(3 * meshlet.triangleCount);
+    if (!firstIndices.empty() &&
+        firstIndices.back() + uint32_t(indexCounts.back()) ==
+            meshlet.firstIndex) {
+      indexCounts.back() += indexCount;
+    } else {
+      firstIndices.emplace_back(meshlet.firstIndex);
+      indexCounts.emplace_back(indexCount);
+    }
+  }
+}
+
+float computeLodPixelsPerUnit(const ArenaBlock &vertexBlock,
+    const glm::mat4 &modelViewMatrix, const glm::mat4 &projMatrix,
+    float viewportHeight)
+{
+  // The sphere scales with the largest scale of the matrix
+  const auto scale = std::max(glm::length(glm::vec3(modelViewMatrix[0])),
+      std::max(glm::length(glm::vec3(modelViewMatrix[1])),
+          glm::length(glm::vec3(modelViewMatrix[2]))));
+  const auto center = getPositionCenter(vertexBlock);
+  const auto radius = glm::length(getPositionHalfExtent(vertexBlock));
+  const auto distance =
+      glm::length(glm::vec3(modelViewMatrix * glm::vec4(center, 1.f))) -
+      scale * radius;
+  if (distance <= 0.f) {
+    return 0.f;
+  }
+  return scale * projMatrix[1][1] * 0.5f * viewportHeight / distance;
+}
+
+size_t selectLod(
+    const ArenaPrimitive &primitive, float pixelsPerUnit, size_t previousLod)
+{
+  if (pixelsPerUnit <= 0.f) {
+    return 0;
+  }
+  const auto getPixelError = [&](size_t lod) {
+    return lod == 0 ? 0.f : primitive.lods[lod - 1].error * pixelsPerUnit;
+  };
+  auto lod = std::min(previousLod, primitive.lods.size());
+  // Finer levels once the level drawn is clearly too coarse, down to the
+  // coarsest one that is fine enough
+  if (getPixelError(lod) > LOD_MAX_PIXEL_ERROR * LOD_HYSTERESIS) {
+    while (lod > 0 && getPixelError(lod) > LOD_MAX_PIXEL_ERROR) {
+      --lod;
+    }
+    return lod;
+  }
+  // Coarser levels as long as they are clearly fine enough
+  while (lod < primitive.lods.size() &&
+         getPixelError(lod + 1) < LOD_MAX_PIXEL_ERROR / LOD_HYSTERESIS) {
+    ++lod;
+  }
+  return lod;
+}
+
+unsigned getVertexAttribMask(const ArenaBlock &vertexBlock)
+{
+  unsigned attribMask = 0;
+  for (int attrib = 0; attrib < VERTEX_ATTRIB_COUNT; ++attrib) {
+    if (vertexBlock.attribAccessors[attrib] >= 0) {
+      attribMask |= 1u << attrib;
+    }
+  }
+  return attribMask;
+}
+
+glm::mat4 getDequantizationMatrix(
+    const VertexFormat &format, const ArenaBlock &vertexBlock)
+{
+  if (!format.isQuantized) {
+    return glm::mat4(1);
+  }
+  const auto center = getPositionCenter(vertexBlock);
+  const auto halfExtent = getPositionHalfExtent(vertexBlock);
+  return glm::scale(glm::translate(glm::mat4(1), center), halfExtent);
+}
+
+size_t getArenaBlockByteSize(
+    const VertexFormat &format, const ArenaBlock &block)
+{
+  if (block.indexAccessor >= 0) {
+    return block.count * block.indexByteSize;
+  }
+  if (format.isInterleaved) {
+    return getArenaVertexBufferSize(format, block.count);
+  }
+  size_t byteSize = 0;
+  for (int attrib = 0; attrib < VERTEX_ATTRIB_COUNT; ++attrib) {
+    if (block.attribAccessors[attrib] >= 0) {
+      byteSize += block.count * getVertexAttribFormat(format, attrib).byteSize;
+    }
+  }
+  return byteSize;
+}
+
+size_t getArenaBlockUnitCount(const ArenaBlock &block)
+{
+  if (block.indexAccessor < 0) {
+    return block.count;
+  }
+  return (block.count * block.indexByteSize + ARENA_INDEX_UNIT_BYTE_SIZE - 1) /
+         ARENA_INDEX_UNIT_BYTE_SIZE;
+}
+
+GLenum getIndexType(const ArenaBlock &indexBlock)
+{
+  switch (indexBlock.indexByteSize) {
+  case sizeof(uint8_t):
+    return GL_UNSIGNED_BYTE;
+  case sizeof(uint16_t):
+    return GL_UNSIGNED_SHORT;
+  }
+  return GL_UNSIGNED_INT;
+}
+
+bool isMeshUploaded(const GeometryLayout &layout, int meshIdx)
+{
+  const auto first = layout.meshFirstPrimitives[meshIdx];
+  const auto last = size_t(meshIdx + 1) < layout.meshFirstPrimitives.size()
+                        ? layout.meshFirstPrimitives[meshIdx + 1]
+                        : layout.primitives.size();
+  for (auto i = first; i < last; ++i) {
+    const auto &primitive = layout.primitives[i];
+    if ((primitive.vertexBlock >= 0 &&
+            !layout.vertexBlocks[primitive.vertexBlock].isUploaded) ||
+        (primitive.indexBlock >= 0 &&
+            !layout.indexBlocks[primitive.indexBlock].isUploaded)) {
+      return false;
+    }
+    for (const auto &lod : primitive.lods) {
+      if (!layout.indexBlocks[lod.indexBlock].isUploaded) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+size_t getVertexCount(const GeometryLayout &layout)
+{
+  return getBlockUnitCount(layout.vertexBlocks);
+}
+
+size_t getIndexUnitCount(const GeometryLayout &layout)
+{
+  return getBlockUnitCount(layout.indexBlocks);
+}
+
+void reuseArenaBlocks(const GeometryLayout &previousLayout,
+    GeometryLayout &layout, RangeAllocator &vertexAllocator,
+    RangeAllocator &indexAllocator)
+{
+  // Keys of blocks from different files only identify the same content if
+  // they hash it
+  const auto canReuse = previousLayout.hasContentKeys && layout.hasContentKeys;
+  reuseBlocks(previousLayout.vertexBlocks, canReuse, layout.vertexBlocks,
+      vertexAllocator);
+  reuseBlocks(previousLayout.indexBlocks, canReuse, layout.indexBlocks,
+      indexAllocator);
+}
+
+bool allocateArenaBlocks(GeometryLayout &layout,
+    RangeAllocator &vertexAllocator, RangeAllocator &indexAllocator)
+{
+  return allocateBlocks(layout.vertexBlocks, vertexAllocator) &&
+         allocateBlocks(layout.indexBlocks, indexAllocator);
+}
+
+void convertIndices(const tinygltf::Model &model, const GltfBuffers &buffers,
+    const ArenaBlock &indexBlock, size_t first, size_t count,
+    unsigned char *dst)
+{
+  if (indexBlock.indexByteSize == sizeof(uint32_t) &&
+      indexBlock.minIndex == 0) {
+    readIndices(model, buffers, indexBlock.indexAccessor, first, count,
+        reinterpret_cast<uint32_t *>(dst));
+    return;
+  }
+  const size_t BATCH_SIZE = 4096;
+  uint32_t indices[BATCH_SIZE];
+  for (size_t batchFirst = 0; batchFirst < count; batchFirst += BATCH_SIZE) {
+    const auto batchCount = std::min(BATCH_SIZE, count - batchFirst);
+    readIndices(model, buffers, indexBlock.indexAccessor, first + batchFirst,
+        batchCount, indices);
+    auto *batchDst = dst + batchFirst * indexBlock.indexByteSize;
+    switch (indexBlock.indexByteSize) {
+    case sizeof(uint8_t):
+      narrowIndices<uint8_t>(
+          indices, batchCount, indexBlock.minIndex, batchDst);
+      break;
+    case sizeof(uint16_t):
+      narrowIndices<uint16_t>(
+          indices, batchCount, indexBlock.minIndex, batchDst);
+      break;
+    default:
+      narrowIndices<uint32_t>(
+          indices, batchCount, indexBlock.minIndex, batchDst);
+    }
+  }
+}
+
+BufferBytes getAccessorBytes(const tinygltf::Model &model,
+    const GltfBuffers &buffers, int accessorIdx, size_t first, size_t count)
+{
+  const auto &accessor = model.accessors[accessorIdx];
+  if (accessor.bufferView < 0 || count == 0) {
+    return BufferBytes{};
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  const auto byteStride = size_t(accessor.ByteStride(bufferView));
+  BufferBytes bytes;
+  bytes.data = buffers.bytes[bufferView.buffer].data + bufferView.byteOffset +
+               accessor.byteOffset + first * byteStride;
+  bytes.size = (count - 1) * byteStride + getElementByteSize(accessor);
+  return bytes;
+}
+
+void readVertexAttrib(const tinygltf::Model &model, const GltfBuffers &buffers,
+    int accessorIdx, int componentCount, size_t first, size_t count,
+    float *dst, size_t dstStride)
+{
+  const auto &accessor = model.accessors[accessorIdx];
+  const auto bytes =
+      getAccessorBytes(model, buffers, accessorIdx, first, count);
+  if (!bytes.data) {
+    for (size_t i = 0; i < count; ++i) {
+      std::fill(dst + i * dstStride, dst + i * dstStride + componentCount, 0.f);
+    }
+    return;
+  }
+  const auto byteStride =
+      size_t(accessor.ByteStride(model.bufferViews[accessor.bufferView]));
+  const auto accessorComponentCount =
+      tinygltf::GetNumComponentsInType(accessor.type);
+  const auto componentByteSize =
+      size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType));
+  // Floats, the common case, are copied as is
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT &&
+      accessorComponentCount == componentCount) {
+    const auto elementByteSize = componentCount * sizeof(float);
+    if (byteStride == elementByteSize && dstStride == size_t(componentCount)) {
+      std::memcpy(dst, bytes.data, count * byteStride);
+      return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      std::memcpy(dst + i * dstStride, bytes.data + i * byteStride,
+          elementByteSize);
+    }
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    const auto element = bytes.data + i * byteStride;
+    for (int c = 0; c < componentCount; ++c) {
+      dst[i * dstStride + c] =
+          c < accessorComponentCount
+              ? readComponent(element + c * componentByteSize,
+                    accessor.componentType, accessor.normalized)
+              : 0.f;
+    }
+  }
+}
+
+void convertVertexAttrib(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const VertexFormat &format,
+    const ArenaBlock &vertexBlock, int attrib, size_t first, size_t count,
+    unsigned char *dst, size_t dstByteStride)
+{
+  const auto accessorIdx = vertexBlock.attribAccessors[attrib];
+  const auto componentCount = getVertexAttribComponentCount(attrib);
+  if (!format.isQuantized) {
+    readVertexAttrib(model, buffers, accessorIdx, componentCount, first, count,
+        reinterpret_cast<float *>(dst), dstByteStride / sizeof(float));
+    return;
+  }
+  const auto center = getPositionCenter(vertexBlock);
+  const auto halfExtent = getPositionHalfExtent(vertexBlock);
+  // Read as floats by batches that stay in cache, then quantized
+  const size_t BATCH_SIZE = 1024;
+  float values[3 * BATCH_SIZE];
+  for (size_t batchFirst = 0; batchFirst < count; batchFirst += BATCH_SIZE) {
+    const auto batchCount = std::min(BATCH_SIZE, count - batchFirst);
+    readVertexAttrib(model, buffers, accessorIdx, componentCount,
+        first + batchFirst, batchCount, values, componentCount);
+    for (size_t i = 0; i < batchCount; ++i) {
+      const auto *value = values + i * componentCount;
+      auto *element = dst + (batchFirst + i) * dstByteStride;
+      if (attrib == VERTEX_ATTRIB_POSITION) {
+        int16_t quantized[4] = {};
+        for (int c = 0; c < 3; ++c) {
+          quantized[c] = quantizeSnorm16(halfExtent[c] > 0.f
+                                             ? (value[c] - center[c]) /
+                                                   halfExtent[c]
+                                             : 0.f);
+        }
+        std::memcpy(element, quantized, sizeof(quantized));
+      } else if (attrib == VERTEX_ATTRIB_NORMAL) {
+        const auto coords =
+            encodeOctahedral(glm::vec3(value[0], value[1], value[2]));
+        const int16_t quantized[2] = {
+            quantizeSnorm16(coords.x), quantizeSnorm16(coords.y)};
+        std::memcpy(element, quantized, sizeof(quantized));
+      } else {
+        const uint16_t halves[2] = {
+            glm::packHalf1x16(value[0]), glm::packHalf1x16(value[1])};
+        std::memcpy(element, halves, sizeof(halves));
+      }
+    }
+  }
+}
+
+void readIndices(const tinygltf::Model &model, const GltfBuffers &buffers,
+    int accessorIdx, size_t first, size_t count, uint32_t *dst)
+{
+  const auto &accessor = model.accessors[accessorIdx];
+  const auto bytes =
+      getAccessorBytes(model, buffers, accessorIdx, first, count);
+  if (!bytes.data) {
+    std::fill(dst, dst + count, 0u);
+    return;
+  }
+  const auto byteStride =
+      size_t(accessor.ByteStride(model.bufferViews[accessor.bufferView]));
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT &&
+      byteStride == sizeof(uint32_t)) {
+    std::memcpy(dst, bytes.data, count * sizeof(uint32_t));
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    const auto element = bytes.data + i * byteStride;
+    if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+      dst[i] = *element;
+    } else if (accessor.componentType ==
+               TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+      uint16_t index;
+      std::memcpy(&index, element, sizeof(index));
+      dst[i] = index;
+    } else {
+      std::memcpy(&dst[i], element, sizeof(uint32_t));
+    }
+  }
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <string>
+#include <tiny_gltf.h>
+#include <vector>
+
+// Vertex attributes read by the shaders, values are attribute locations
+enum VertexAttrib
+{
+  VERTEX_ATTRIB_POSITION = 0,
+  VERTEX_ATTRIB_NORMAL = 1,
+  VERTEX_ATTRIB_TEXCOORD0 = 2,
+  VERTEX_ATTRIB_COUNT = 3
+};
+
+// glTF semantic of a vertex attribute, e.g. "TEXCOORD_0"
+const char *getVertexAttribName(int attrib);
+
+// Components of an attribute read from glTF accessors, e.g. 3 for NORMAL
+int getVertexAttribComponentCount(int attrib);
+
+// Layout of the vertices in an arena vertex buffer. By default attributes are
+// stored in consecutive regions of vertexCapacity elements each, so that a
+// vertex has the same index in all of them. Interleaved, the attributes of a
+// vertex are next to each other in a single stream, so that fetching a vertex
+// reads one cache line instead of one per attribute. Attributes a vertex block
+// does not have are then left as zeros.
+//
+// Attributes are floats, or quantized to about half their size:
+// - positions to 16 bits normalized integers in the bounds of their vertex
+// block, see getDequantizationMatrix()
+// - normals to 16 bits normalized octahedral coordinates, that the vertex
+// shader decodes
+// - texture coordinates to half floats
+struct VertexFormat
+{
+  bool isInterleaved = false;
+  bool isQuantized = false;
+};
+
+// Arguments of glVertexAttribFormat() for an attribute stored in a format
+struct VertexAttribFormat
+{
+  GLint componentCount;
+  GLenum type;
+  GLboolean isNormalized;
+  size_t byteSize;
+};
+
+VertexAttribFormat getVertexAttribFormat(
+    const VertexFormat &format, int attrib);
+
+// Bytes between two consecutive vertices in the stream of an attribute
+size_t getVertexAttribStride(const VertexFormat &format, int attrib);
+
+// Offset of the first vertex of an attribute in an arena vertex buffer
+size_t getVertexAttribOffset(
+    const VertexFormat &format, int attrib, size_t vertexCapacity);
+
+size_t getArenaVertexBufferSize(
+    const VertexFormat &format, size_t vertexCapacity);
+
+// Indices are stored as unsigned integers of 1, 2 or 4 bytes in the arena,
+// which is allocated in units of 4 bytes so that every block is aligned
+const size_t ARENA_INDEX_UNIT_BYTE_SIZE = sizeof(uint32_t);
+
+// First fit allocator of ranges of elements in [0, capacity)
+class RangeAllocator
+{
+public:
+  RangeAllocator() = default;
+
+  explicit RangeAllocator(size_t capacity);
+
+  // Return false if no free range is large enough
+  bool allocate(size_t count, size_t &first);
+
+  // The range must have been returned by allocate()
+  void free(size_t first, size_t count);
+
+  size_t capacity() const { return m_capacity; }
+
+private:
+  // First element to element count, ranges are disjoint and not contiguous
+  std::map<size_t, size_t> m_freeRanges;
+  size_t m_capacity = 0;
+};
+
+// Vertices or indices of the arena, shared by all primitives reading the same
+// accessors
+struct ArenaBlock
+{
+  uint64_t key = 0; // Identifies the content of the block
+  // Vertex blocks: accessor of each attribute, -1 if the primitive has none
+  int attribAccessors[VERTEX_ATTRIB_COUNT] = {-1, -1, -1};
+  int indexAccessor = -1; // Index blocks: accessor of the indices
+  // Vertex blocks: bounds of the positions
+  glm::vec3 positionMin = glm::vec3(0.f);
+  glm::vec3 positionMax = glm::vec3(0.f);
+  // Index blocks: indices are stored minus minIndex, as the smallest integers
+  // that fit maxIndex - minIndex
+  uint32_t minIndex = 0;
+  uint32_t maxIndex = 0;
+  size_t indexByteSize = sizeof(uint32_t);
+  size_t count = 0; // Number of vertices or indices
+  size_t first = 0; // Position in the arena, in vertices or index units
+  bool isAllocated = false;
+  bool isRequested = false; // Queued for upload
+  bool isUploaded = false;
+};
+
+// Consecutive triangles of an indexed primitive, with bounds to cull them on
+// their own, in the space of the positions of the primitive
+struct Meshlet
+{
+  uint32_t firstIndex = 0; // In the indices of the primitive
+  uint32_t triangleCount = 0;
+  glm::vec3 center = glm::vec3(0.f); // Bounding sphere
+  float radius = 0.f;
+  // Normals of the triangles are in the cone of this axis whose half angle
+  // has cosine sqrt(1 - coneCutoff^2). coneCutoff is 1 if the cone is too wide
+  // for the meshlet to ever face away.
+  glm::vec3 coneAxis = glm::vec3(0.f);
+  float coneCutoff = 1.f;
+};
+
+// Attributes of a primitive split into meshlets, with one element per meshlet
+// holding the members of Meshlet: (firstIndex, triangleCount) as unsigned
+// integers, (center, radius) and (coneAxis, coneCutoff) as floats. Primitives
+// are split by the meshlet import stage.
+const char MESHLET_RANGES_ATTRIBUTE[] = "_MESHLET_RANGES";
+const char MESHLET_SPHERES_ATTRIBUTE[] = "_MESHLET_SPHERES";
+const char MESHLET_CONES_ATTRIBUTE[] = "_MESHLET_CONES";
+
+// Attributes of a primitive with simplified levels of detail: the indices of
+// level i, from 1, in LOD_INDICES_ATTRIBUTE followed by i, and the error of
+// each level, in units of the positions, as floats in LOD_ERRORS_ATTRIBUTE.
+// Levels are built by the level of detail import stage.
+const size_t MAX_LOD_COUNT = 4;
+const char LOD_INDICES_ATTRIBUTE[] = "_LOD_INDICES_";
+const char LOD_ERRORS_ATTRIBUTE[] = "_LOD_ERRORS";
+
+// False for the attributes above, which are not per vertex
+bool isVertexAttribute(const std::string &name);
+
+// Read the meshlets of a primitive. Return false, leaving meshlets empty, if
+// it has none or they cannot be read.
+bool readMeshlets(const tinygltf::Model &model, const GltfBuffers &buffers,
+    const tinygltf::Primitive &primitive, std::vector<Meshlet> &meshlets);
+
+// First index and index count of the meshlets that may be visible, drawn with
+// this model view projection matrix from cameraPosition, in the space of
+// their positions. Meshlets out of the view frustum, or whose normal cone
+// faces away from the camera, are culled. Consecutive ranges are merged.
+void cullMeshlets(const std::vector<Meshlet> &meshlets,
+    const glm::mat4 &modelViewProjMatrix, const glm::vec3 &cameraPosition,
+    std::vector<uint32_t> &firstIndices, std::vector<GLsizei> &indexCounts);
+
+// Simplified level of detail of a primitive, drawing the same vertices
+struct ArenaLod
+{
+  int indexBlock = -1;
+  float error = 0.f; // In units of the positions
+};
+
+struct ArenaPrimitive
+{
+  int mode = TINYGLTF_MODE_TRIANGLES;
+  int vertexBlock = -1; // -1 if the primitive cannot be drawn
+  int indexBlock = -1; // -1 if the primitive is not indexed
+  // In the range of the indices of indexBlock, empty if the primitive has no
+  // meshlets and is drawn at once
+  std::vector<Meshlet> meshlets;
+  // From the finest, of increasing errors
+  std::vector<ArenaLod> lods;
+};
+
+// Error on screen, in pixels, below which a level of detail may be drawn. A
+// level is only switched to once its error is LOD_HYSTERESIS times lower, and
+// left once it is LOD_HYSTERESIS times higher, so that primitives near a
+// threshold do not switch levels every frame.
+const float LOD_MAX_PIXEL_ERROR = 1.f;
+const float LOD_HYSTERESIS = 1.5f;
+
+// Pixels per unit of the positions of a vertex block at the point of its
+// bounding sphere closest to the camera, 0 if the camera is in the sphere
+float computeLodPixelsPerUnit(const ArenaBlock &vertexBlock,
+    const glm::mat4 &modelViewMatrix, const glm::mat4 &projMatrix,
+    float viewportHeight);
+
+// Level of detail to draw a primitive with, 0 for indexBlock and i for
+// lods[i - 1], given the level drawn in the previous frame
+size_t selectLod(
+    const ArenaPrimitive &primitive, float pixelsPerUnit, size_t previousLod);
+
+// Placement of the geometry of a model in the arena
+struct GeometryLayout
+{
+  std::vector<ArenaBlock> vertexBlocks;
+  std::vector<ArenaBlock> indexBlocks;
+  std::vector<ArenaPrimitive> primitives; // All primitives of all meshes
+  std::vector<size_t> meshFirstPrimitives; // Indexed like meshes
+  // True if block keys hash the content of the accessors, so that they can be
+  // compared with the keys of another model
+  bool hasContentKeys = false;
+};
+
+// Blocks of every primitive, not allocated yet. Primitives reading the same
+// accessors, or accessors with the same content if bufferViewHashes is not
+// empty, share their blocks. Invalid accessors are skipped. Position bounds
+// are the min and max of the accessors, computed if they lack them. Index
+// ranges are computed from the indices. Meshlets and levels of detail are read
+// if primitives have valid ones, levels of detail have their own index blocks.
+GeometryLayout computeGeometryLayout(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const std::vector<uint64_t> &bufferViewHashes);
+
+// Bit i is set if a vertex block has attribute i, primitives with the same
+// mask have the same vertex layout in the arena
+unsigned getVertexAttribMask(const ArenaBlock &vertexBlock);
+
+// Transform from the positions of a vertex block, as stored in the arena, to
+// the positions of its accessor. Identity if positions are not quantized.
+glm::mat4 getDequantizationMatrix(
+    const VertexFormat &format, const ArenaBlock &vertexBlock);
+
+// Bytes of a block in the arena
+size_t getArenaBlockByteSize(
+    const VertexFormat &format, const ArenaBlock &block);
+
+// Vertices or index units of a block in the arena
+size_t getArenaBlockUnitCount(const ArenaBlock &block);
+
+// GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+GLenum getIndexType(const ArenaBlock &indexBlock);
+
+// True if the blocks of every drawable primitive of the mesh, and of their
+// levels of detail, are uploaded
+bool isMeshUploaded(const GeometryLayout &layout, int meshIdx);
+
+// Total number of vertices and index units of the blocks
+size_t getVertexCount(const GeometryLayout &layout);
+size_t getIndexUnitCount(const GeometryLayout &layout);
+
+// Blocks of layout with the key of an uploaded block of previousLayout take its
+// place in the arena, the other blocks of previousLayout are freed
+void reuseArenaBlocks(const GeometryLayout &previousLayout,
+    GeometryLayout &layout, RangeAllocator &vertexAllocator,
+    RangeAllocator &indexAllocator);
+
+// Allocate the blocks that are not allocated yet. Return false if the arena is
+// too small, blocks allocated so far are kept.
+bool allocateArenaBlocks(GeometryLayout &layout,
+    RangeAllocator &vertexAllocator, RangeAllocator &indexAllocator);
+
+// Convert elements [first, first + count) of a vertex attribute accessor to
+// componentCount floats each, written dstStride floats apart
+void readVertexAttrib(const tinygltf::Model &model, const GltfBuffers &buffers,
+    int accessorIdx, int componentCount, size_t first, size_t count,
+    float *dst, size_t dstStride);
+
+// Convert vertices [first, first + count) of an attribute of a vertex block
+// to its format in the arena, written dstByteStride bytes apart
+void convertVertexAttrib(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const VertexFormat &format,
+    const ArenaBlock &vertexBlock, int attrib, size_t first, size_t count,
+    unsigned char *dst, size_t dstByteStride);
+
+// Bytes of an element of an accessor
+size_t getElementByteSize(const tinygltf::Accessor &accessor);
+
+// True if every element of the accessor lies in its bufferView and buffer.
+// Accessors without bufferView are read as zeros.
+bool isAccessorReadable(
+    const tinygltf::Model &model, const GltfBuffers &buffers, int accessorIdx);
+
+// True if an accessor holds valid elements of a vertex attribute that
+// readVertexAttrib() can read
+bool isVertexAttribReadable(const tinygltf::Model &model,
+    const GltfBuffers &buffers, int accessorIdx, int attrib);
+
+// True if an accessor holds valid indices that readIndices() can read
+bool isIndicesReadable(
+    const tinygltf::Model &model, const GltfBuffers &buffers, int accessorIdx);
+
+// Convert elements [first, first + count) of an indices accessor
+void readIndices(const tinygltf::Model &model, const GltfBuffers &buffers,
+    int accessorIdx, size_t first, size_t count, uint32_t *dst);
+
+// Convert elements [first, first + count) of the indices of an index block to
+// its format in the arena
+void convertIndices(const tinygltf::Model &model, const GltfBuffers &buffers,
+    const ArenaBlock &indexBlock, size_t first, size_t count,
+    unsigned char *dst);
+
+// Bytes read by readVertexAttrib() or readIndices() for these elements
+BufferBytes getAccessorBytes(const tinygltf::Model &model,
+    const GltfBuffers &buffers, int accessorIdx, size_t first, size_t count);
@@ -0,0 +1,88 @@
+#include "gl_objects.hpp"
+
+#include <iterator>
+#include <utility>
+
+GLBuffer createBuffer(size_t byteCount, GLbitfield flags)
+{
+  auto buffer = GLBuffer::generate();
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.glId());
+  glBufferStorage(GL_COPY_WRITE_BUFFER, GLsizeiptr(byteCount), nullptr, flags);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  return buffer;
+}
+
+GLTexture createTexture2D(GLenum internalFormat, GLsizei width, GLsizei height)
+{
+  auto texture = GLTexture::generate();
+  glBindTexture(GL_TEXTURE_2D, texture.glId());
+  glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texture;
+}
+
+size_t getBufferSizeClass(size_t byteCount)
+{
+  if (byteCount <= GL_BUFFER_MIN_SIZE_CLASS) {
+    return GL_BUFFER_MIN_SIZE_CLASS;
+  }
+  // A quarter of the largest power of two not above byteCount
+  size_t step = 1;
+  while (step <= byteCount / 2) {
+    step *= 2;
+  }
+  step /= 4;
+  return (byteCount + step - 1) / step * step;
+}
+
+GLBuffer GLObjectPool::acquireBuffer(size_t byteCount)
+{
+  const auto sizeClass = getBufferSizeClass(byteCount);
+  const auto it = m_freeBuffers.find(sizeClass);
+  if (it == end(m_freeBuffers)) {
+    return createBuffer(sizeClass, 0);
+  }
+  auto buffer = std::move(it->second);
+  m_freeBuffers.erase(it);
+  m_nFreeByteCount -= sizeClass;
+  return buffer;
+}
+
+void GLObjectPool::releaseBuffer(GLBuffer buffer, size_t byteCount)
+{
+  if (!buffer) {
+    return;
+  }
+  const auto sizeClass = getBufferSizeClass(byteCount);
+  m_freeBuffers.emplace(sizeClass, std::move(buffer));
+  m_nFreeByteCount += sizeClass;
+  trim();
+}
+
+GLVertexArray GLObjectPool::acquireVertexArray()
+{
+  if (m_freeVertexArrays.empty()) {
+    return GLVertexArray::generate();
+  }
+  auto vertexArray = std::move(m_freeVertexArrays.back());
+  m_freeVertexArrays.pop_back();
+  return vertexArray;
+}
+
+void GLObjectPool::releaseVertexArray(GLVertexArray vertexArray)
+{
+  if (vertexArray) {
+    m_freeVertexArrays.emplace_back(std::move(vertexArray));
+  }
+}
+
+void GLObjectPool::trim()
+{
+  // Largest buffers first, they free the most memory for the fewest objects
+  // to create again
+  while (m_nFreeByteCount > m_nMaxFreeByteCount && !m_freeBuffers.empty()) {
+    const auto it = std::prev(end(m_freeBuffers));
+    m_nFreeByteCount -= it->first;
+    m_freeBuffers.erase(it);
+  }
+}
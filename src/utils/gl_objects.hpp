@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <glad/glad.h>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Owner of the name of an OpenGL object, deleted with it, like GLShader and
+// GLProgram. A default constructed object owns no name, generate() returns
+// one owning a new name. Traits provide the functions generating and deleting
+// names of the type of object.
+template <typename Traits> class GLObject
+{
+  GLuint m_GLId = 0;
+
+public:
+  GLObject() = default;
+
+  ~GLObject() { reset(); }
+
+  GLObject(const GLObject &) = delete;
+
+  GLObject &operator=(const GLObject &) = delete;
+
+  GLObject(GLObject &&rvalue) noexcept : m_GLId(rvalue.m_GLId)
+  {
+    rvalue.m_GLId = 0;
+  }
+
+  GLObject &operator=(GLObject &&rvalue) noexcept
+  {
+    if (this != &rvalue) {
+      reset();
+      m_GLId = rvalue.m_GLId;
+      rvalue.m_GLId = 0;
+    }
+    return *this;
+  }
+
+  static GLObject generate()
+  {
+    GLObject object;
+    Traits::generate(1, &object.m_GLId);
+    return object;
+  }
+
+  GLuint glId() const { return m_GLId; }
+
+  explicit operator bool() const { return m_GLId != 0; }
+
+  // Delete the name, if any
+  void reset()
+  {
+    if (m_GLId) {
+      Traits::destroy(1, &m_GLId);
+      m_GLId = 0;
+    }
+  }
+};
+
+struct GLBufferTraits
+{
+  static void generate(GLsizei n, GLuint *ids) { glGenBuffers(n, ids); }
+  static void destroy(GLsizei n, const GLuint *ids) { glDeleteBuffers(n, ids); }
+};
+
+struct GLVertexArrayTraits
+{
+  static void generate(GLsizei n, GLuint *ids) { glGenVertexArrays(n, ids); }
+  static void destroy(GLsizei n, const GLuint *ids)
+  {
+    glDeleteVertexArrays(n, ids);
+  }
+};
+
+struct GLTextureTraits
+{
+  static void generate(GLsizei n, GLuint *ids) { glGenTextures(n, ids); }
+  static void destroy(GLsizei n, const GLuint *ids)
+  {
+    glDeleteTextures(n, ids);
+  }
+};
+
+struct GLFramebufferTraits
+{
+  static void generate(GLsizei n, GLuint *ids) { glGenFramebuffers(n, ids); }
+  static void destroy(GLsizei n, const GLuint *ids)
+  {
+    glDeleteFramebuffers(n, ids);
+  }
+};
+
+struct GLSamplerTraits
+{
+  static void generate(GLsizei n, GLuint *ids) { glGenSamplers(n, ids); }
+  static void destroy(GLsizei n, const GLuint *ids)
+  {
+    glDeleteSamplers(n, ids);
+  }
+};
+
+struct GLQueryTraits
+{
+  static void generate(GLsizei n, GLuint *ids) { glGenQueries(n, ids); }
+  static void destroy(GLsizei n, const GLuint *ids) { glDeleteQueries(n, ids); }
+};
+
+using GLBuffer = GLObject<GLBufferTraits>;
+using GLVertexArray = GLObject<GLVertexArrayTraits>;
+using GLTexture = GLObject<GLTextureTraits>;
+using GLFramebuffer = GLObject<GLFramebufferTraits>;
+using GLSampler = GLObject<GLSamplerTraits>;
+using GLQuery = GLObject<GLQueryTraits>;
+
+// Sync objects are pointers rather than names
+struct GLSyncDeleter
+{
+  void operator()(GLsync sync) const { glDeleteSync(sync); }
+};
+
+using GLSync =
+    std::unique_ptr<std::remove_pointer<GLsync>::type, GLSyncDeleter>;
+
+// Buffer with immutable storage of byteCount bytes, created with
+// glBufferStorage and flags. Requires a GL 4.4 context.
+GLBuffer createBuffer(size_t byteCount, GLbitfield flags);
+
+// 2D texture with immutable storage of a single level
+GLTexture createTexture2D(GLenum internalFormat, GLsizei width, GLsizei height);
+
+// Buffers are pooled by size class: sizes are rounded up to 4, 5, 6 or 7
+// times a power of two, so that at most a quarter of a buffer is unused, and
+// to at least GL_BUFFER_MIN_SIZE_CLASS bytes
+const size_t GL_BUFFER_MIN_SIZE_CLASS = 64 * 1024;
+
+size_t getBufferSizeClass(size_t byteCount);
+
+// Bytes of free buffers a pool keeps by default, larger buffers are deleted
+// first beyond that
+const size_t GL_OBJECT_POOL_MAX_FREE_BYTE_COUNT = size_t(256) * 1024 * 1024;
+
+// Objects released when a model is reloaded or replaced, kept to be handed out
+// again instead of being created anew. Buffers have immutable storage, so they
+// are reused by size class. Released vertex arrays keep their state, which
+// users must set entirely. Free objects are deleted with the pool, which must
+// be destroyed while the GL context exists.
+class GLObjectPool
+{
+  std::multimap<size_t, GLBuffer> m_freeBuffers; // By size class
+  std::vector<GLVertexArray> m_freeVertexArrays;
+  size_t m_nMaxFreeByteCount = GL_OBJECT_POOL_MAX_FREE_BYTE_COUNT;
+  size_t m_nFreeByteCount = 0;
+
+public:
+  GLObjectPool() = default;
+
+  explicit GLObjectPool(size_t maxFreeByteCount) :
+      m_nMaxFreeByteCount(maxFreeByteCount)
+  {
+  }
+
+  GLObjectPool(const GLObjectPool &) = delete;
+
+  GLObjectPool &operator=(const GLObjectPool &) = delete;
+
+  // Buffer with storage of getBufferSizeClass(byteCount) bytes without CPU
+  // access, for copies and draws only
+  GLBuffer acquireBuffer(size_t byteCount);
+
+  // byteCount is the one the buffer was acquired with
+  void releaseBuffer(GLBuffer buffer, size_t byteCount);
+
+  GLVertexArray acquireVertexArray();
+
+  void releaseVertexArray(GLVertexArray vertexArray);
+
+  // Bytes of the free buffers
+  size_t freeByteCount() const { return m_nFreeByteCount; }
+
+private:
+  void trim();
+};
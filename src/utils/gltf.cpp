@@ -1,4 +1,6 @@
 #include "gltf.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -35,119 +37,252 @@ glm::mat4 getLocalToWorldMatrix(
                                                  node.scale[1], node.scale[2]));
 };
 
-void computeSceneBounds(
-    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax)
+FlatScene flattenScene(const tinygltf::Model &model, int sceneIdx)
+{
+  FlatScene scene;
+  if (sceneIdx < 0 || size_t(sceneIdx) >= model.scenes.size()) {
+    return scene;
+  }
+  // Nodes to visit with the entry of their parent, the next one at the back
+  struct PendingNode
+  {
+    int nodeIdx;
+    int parent;
+  };
+  std::vector<PendingNode> nodeStack;
+  const auto pushChildren = [&](const std::vector<int> &children,
+                                int parent) {
+    for (auto it = children.rbegin(); it != children.rend(); ++it) {
+      nodeStack.push_back({*it, parent});
+    }
+  };
+  pushChildren(model.scenes[sceneIdx].nodes, -1);
+  std::vector<bool> isNodeVisited(model.nodes.size(), false);
+  while (!nodeStack.empty()) {
+    const auto pendingNode = nodeStack.back();
+    nodeStack.pop_back();
+    const auto nodeIdx = pendingNode.nodeIdx;
+    if (nodeIdx < 0 || size_t(nodeIdx) >= model.nodes.size() ||
+        isNodeVisited[nodeIdx]) {
+      continue;
+    }
+    isNodeVisited[nodeIdx] = true;
+    const auto &node = model.nodes[nodeIdx];
+    const auto entry = int(scene.nodes.size());
+    scene.parents.emplace_back(pendingNode.parent);
+    scene.nodes.emplace_back(nodeIdx);
+    scene.meshes.emplace_back(
+        node.mesh >= 0 && size_t(node.mesh) < model.meshes.size() ? node.mesh
+                                                                  : -1);
+    scene.localMatrices.emplace_back(
+        getLocalToWorldMatrix(node, glm::mat4(1)));
+    pushChildren(node.children, entry);
+  }
+  computeWorldMatrices(scene);
+  return scene;
+}
+
+void computeWorldMatrices(FlatScene &scene)
+{
+  scene.worldMatrices.resize(scene.localMatrices.size());
+  for (size_t i = 0; i < scene.localMatrices.size(); ++i) {
+    const auto parent = scene.parents[i];
+    scene.worldMatrices[i] =
+        parent < 0 ? scene.localMatrices[i]
+                   : scene.worldMatrices[parent] * scene.localMatrices[i];
+  }
+}
+
+void computeSceneBounds(const tinygltf::Model &model,
+    const GltfBuffers &buffers, glm::vec3 &bboxMin, glm::vec3 &bboxMax)
 {
-  // Compute scene bounding box
-  // todo refactor with scene drawing
-  // todo need a visitScene generic function that takes a accept() functor
   bboxMin = glm::vec3(std::numeric_limits<float>::max());
   bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
-  if (model.defaultScene >= 0) {
-    const std::function<void(int, const glm::mat4 &)> updateBounds =
-        [&](int nodeIdx, const glm::mat4 &parentMatrix) {
-          const auto &node = model.nodes[nodeIdx];
-          const glm::mat4 modelMatrix =
-              getLocalToWorldMatrix(node, parentMatrix);
-          if (node.mesh >= 0) {
-            const auto &mesh = model.meshes[node.mesh];
-            for (size_t pIdx = 0; pIdx < mesh.primitives.size(); ++pIdx) {
-              const auto &primitive = mesh.primitives[pIdx];
-              const auto positionAttrIdxIt =
-                  primitive.attributes.find("POSITION");
-              if (positionAttrIdxIt == end(primitive.attributes)) {
-                continue;
-              }
-              const auto &positionAccessor =
-                  model.accessors[(*positionAttrIdxIt).second];
-              if (positionAccessor.type != 3) {
-                std::cerr << "Position accessor with type != VEC3, skipping"
-                          << std::endl;
-                continue;
-              }
-              const auto &positionBufferView =
-                  model.bufferViews[positionAccessor.bufferView];
-              const auto byteOffset =
-                  positionAccessor.byteOffset + positionBufferView.byteOffset;
-              const auto &positionBuffer =
-                  model.buffers[positionBufferView.buffer];
-              const auto positionByteStride =
-                  positionBufferView.byteStride ? positionBufferView.byteStride
-                                                : 3 * sizeof(float);
-
-              if (primitive.indices >= 0) {
-                const auto &indexAccessor = model.accessors[primitive.indices];
-                const auto &indexBufferView =
-                    model.bufferViews[indexAccessor.bufferView];
-                const auto indexByteOffset =
-                    indexAccessor.byteOffset + indexBufferView.byteOffset;
-                const auto &indexBuffer = model.buffers[indexBufferView.buffer];
-                auto indexByteStride = indexBufferView.byteStride;
-
-                switch (indexAccessor.componentType) {
-                default:
-                  std::cerr
-                      << "Primitive index accessor with bad componentType "
-                      << indexAccessor.componentType << ", skipping it."
-                      << std::endl;
-                  continue;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint8_t);
-                  break;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint16_t);
-                  break;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint32_t);
-                  break;
-                }
-
-                for (size_t i = 0; i < indexAccessor.count; ++i) {
-                  uint32_t index = 0;
-                  switch (indexAccessor.componentType) {
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                    index = *((const uint8_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                    index = *((const uint16_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                    index = *((const uint32_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  }
-                  const auto &localPosition =
-                      *((const glm::vec3 *)&positionBuffer
-                              .data[byteOffset + positionByteStride * index]);
-                  const auto worldPosition =
-                      glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
-                  bboxMin = glm::min(bboxMin, worldPosition);
-                  bboxMax = glm::max(bboxMax, worldPosition);
-                }
-              } else {
-                for (size_t i = 0; i < positionAccessor.count; ++i) {
-                  const auto &localPosition =
-                      *((const glm::vec3 *)&positionBuffer
-                              .data[byteOffset + positionByteStride * i]);
-                  const auto worldPosition =
-                      glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
-                  bboxMin = glm::min(bboxMin, worldPosition);
-                  bboxMax = glm::max(bboxMax, worldPosition);
-                }
-              }
-            }
-          }
-          for (const auto childNodeIdx : node.children) {
-            updateBounds(childNodeIdx, modelMatrix);
+  const auto scene = flattenScene(model, model.defaultScene);
+  for (size_t nodeEntry = 0; nodeEntry < scene.meshes.size(); ++nodeEntry) {
+    if (scene.meshes[nodeEntry] < 0) {
+      continue;
+    }
+    const auto &modelMatrix = scene.worldMatrices[nodeEntry];
+    const auto &mesh = model.meshes[scene.meshes[nodeEntry]];
+    for (size_t pIdx = 0; pIdx < mesh.primitives.size(); ++pIdx) {
+      const auto &primitive = mesh.primitives[pIdx];
+      const auto positionAttrIdxIt = primitive.attributes.find("POSITION");
+      if (positionAttrIdxIt == end(primitive.attributes)) {
+        continue;
+      }
+      const auto &positionAccessor =
+          model.accessors[(*positionAttrIdxIt).second];
+      if (positionAccessor.type != 3) {
+        std::cerr << "Position accessor with type != VEC3, skipping"
+                  << std::endl;
+        continue;
+      }
+      const auto &positionBufferView =
+          model.bufferViews[positionAccessor.bufferView];
+      const auto byteOffset =
+          positionAccessor.byteOffset + positionBufferView.byteOffset;
+      const auto &positionBuffer = buffers.bytes[positionBufferView.buffer];
+      const auto positionByteStride =
+          positionBufferView.byteStride ? positionBufferView.byteStride
+                                        : 3 * sizeof(float);
+
+      if (primitive.indices >= 0) {
+        const auto &indexAccessor = model.accessors[primitive.indices];
+        const auto &indexBufferView =
+            model.bufferViews[indexAccessor.bufferView];
+        const auto indexByteOffset =
+            indexAccessor.byteOffset + indexBufferView.byteOffset;
+        const auto &indexBuffer = buffers.bytes[indexBufferView.buffer];
+        auto indexByteStride = indexBufferView.byteStride;
+
+        switch (indexAccessor.componentType) {
+        default:
+          std::cerr << "Primitive index accessor with bad componentType "
+                    << indexAccessor.componentType << ", skipping it."
+                    << std::endl;
+          continue;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+          indexByteStride = indexByteStride ? indexByteStride : sizeof(uint8_t);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+          indexByteStride =
+              indexByteStride ? indexByteStride : sizeof(uint16_t);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+          indexByteStride =
+              indexByteStride ? indexByteStride : sizeof(uint32_t);
+          break;
+        }
+
+        for (size_t i = 0; i < indexAccessor.count; ++i) {
+          uint32_t index = 0;
+          switch (indexAccessor.componentType) {
+          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            index = *((const uint8_t *)&indexBuffer
+                          .data[indexByteOffset + indexByteStride * i]);
+            break;
+          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            index = *((const uint16_t *)&indexBuffer
+                          .data[indexByteOffset + indexByteStride * i]);
+            break;
+          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            index = *((const uint32_t *)&indexBuffer
+                          .data[indexByteOffset + indexByteStride * i]);
+            break;
           }
-        };
-    for (const auto nodeIdx : model.scenes[model.defaultScene].nodes) {
-      updateBounds(nodeIdx, glm::mat4(1));
+          const auto &localPosition =
+              *((const glm::vec3 *)&positionBuffer
+                      .data[byteOffset + positionByteStride * index]);
+          const auto worldPosition =
+              glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
+          bboxMin = glm::min(bboxMin, worldPosition);
+          bboxMax = glm::max(bboxMax, worldPosition);
+        }
+      } else {
+        for (size_t i = 0; i < positionAccessor.count; ++i) {
+          const auto &localPosition =
+              *((const glm::vec3 *)&positionBuffer
+                      .data[byteOffset + positionByteStride * i]);
+          const auto worldPosition =
+              glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
+          bboxMin = glm::min(bboxMin, worldPosition);
+          bboxMax = glm::max(bboxMax, worldPosition);
+        }
+      }
+    }
+  }
+}
+
+namespace
+{
+
+// Mark the bufferViews read by the vertex attributes and indices of a mesh
+void markMeshBufferViews(const tinygltf::Model &model,
+    const tinygltf::Mesh &mesh, std::vector<bool> &isBufferViewMarked)
+{
+  const auto markAccessor = [&](int accessorIdx) {
+    if (accessorIdx < 0 || size_t(accessorIdx) >= model.accessors.size()) {
+      return;
     }
+    const auto bufferViewIdx = model.accessors[accessorIdx].bufferView;
+    if (bufferViewIdx >= 0 &&
+        size_t(bufferViewIdx) < model.bufferViews.size()) {
+      isBufferViewMarked[bufferViewIdx] = true;
+    }
+  };
+  for (const auto &primitive : mesh.primitives) {
+    for (const auto &attribute : primitive.attributes) {
+      markAccessor(attribute.second);
+    }
+    markAccessor(primitive.indices);
+  }
+}
+
+std::vector<int> getMarkedIndices(const std::vector<bool> &isMarked)
+{
+  std::vector<int> indices;
+  for (size_t i = 0; i < isMarked.size(); ++i) {
+    if (isMarked[i]) {
+      indices.emplace_back(int(i));
+    }
+  }
+  return indices;
+}
+
+} // namespace
+
+std::vector<int> computeSceneMeshes(const tinygltf::Model &model, int sceneIdx)
+{
+  std::vector<bool> isMeshReachable(model.meshes.size(), false);
+  std::vector<bool> isNodeVisited(model.nodes.size(), false);
+  std::vector<int> nodeStack;
+  if (sceneIdx >= 0 && size_t(sceneIdx) < model.scenes.size()) {
+    nodeStack = model.scenes[sceneIdx].nodes;
   }
-}
\ No newline at end of file
+  while (!nodeStack.empty()) {
+    const auto nodeIdx = nodeStack.back();
+    nodeStack.pop_back();
+    // Invalid files may have cycles or shared nodes, visit each node once
+    if (nodeIdx < 0 || size_t(nodeIdx) >= model.nodes.size() ||
+        isNodeVisited[nodeIdx]) {
+      continue;
+    }
+    isNodeVisited[nodeIdx] = true;
+    const auto &node = model.nodes[nodeIdx];
+    nodeStack.insert(end(nodeStack), begin(node.children), end(node.children));
+    if (node.mesh >= 0 && size_t(node.mesh) < model.meshes.size()) {
+      isMeshReachable[node.mesh] = true;
+    }
+  }
+  return getMarkedIndices(isMeshReachable);
+}
+
+std::vector<int> computeMeshBufferViews(const tinygltf::Model &model)
+{
+  std::vector<bool> isBufferViewRead(model.bufferViews.size(), false);
+  for (const auto &mesh : model.meshes) {
+    markMeshBufferViews(model, mesh, isBufferViewRead);
+  }
+  return getMarkedIndices(isBufferViewRead);
+}
+
+std::vector<uint64_t> computeBufferViewHashes(
+    const tinygltf::Model &model, const GltfBuffers &buffers)
+{
+  std::vector<uint64_t> hashes(model.bufferViews.size(), 0);
+  const auto bufferViews = computeMeshBufferViews(model);
+  parallelFor(bufferViews.size(), [&](size_t i) {
+    const auto &bufferView = model.bufferViews[bufferViews[i]];
+    if (bufferView.buffer < 0 ||
+        size_t(bufferView.buffer) >= buffers.bytes.size()) {
+      return;
+    }
+    const auto &bytes = buffers.bytes[bufferView.buffer];
+    if (bufferView.byteOffset + bufferView.byteLength <= bytes.size) {
+      hashes[bufferViews[i]] =
+          hash64(bytes.data + bufferView.byteOffset, bufferView.byteLength);
+    }
+  });
+  return hashes;
+}
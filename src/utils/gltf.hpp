@@ -1,10 +1,50 @@
 #pragma once
 
+#include "gltf_loader.hpp"
+
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <tiny_gltf.h>
+#include <vector>
 
 glm::mat4 getLocalToWorldMatrix(
     const tinygltf::Node &node, const glm::mat4 &parentMatrix);
 
-void computeSceneBounds(
-    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax);
\ No newline at end of file
+// Nodes of a scene in contiguous arrays, one entry per node, parents before
+// their children and children in the order of their parent, so that world
+// matrices are computed in a single pass and nodes are drawn in the order of
+// a depth first traversal, without recursion.
+struct FlatScene
+{
+  std::vector<int> parents; // Entry of the parent, -1 for root nodes
+  std::vector<int> nodes; // Index of the node in the model
+  std::vector<int> meshes; // -1 for nodes without mesh
+  std::vector<glm::mat4> localMatrices; // From the TRS or matrix of the node
+  std::vector<glm::mat4> worldMatrices;
+};
+
+// Flatten the nodes reachable from a scene, with their world matrices. Nodes
+// are visited once, the first time they are reached, so that invalid files
+// with cycles or shared nodes are flattened as trees. Empty if sceneIdx is
+// not a scene.
+FlatScene flattenScene(const tinygltf::Model &model, int sceneIdx);
+
+// Compute the world matrices from the local matrices, in entry order
+void computeWorldMatrices(FlatScene &scene);
+
+// Bounds of the vertices drawn by the default scene, in world space
+void computeSceneBounds(const tinygltf::Model &model,
+    const GltfBuffers &buffers, glm::vec3 &bboxMin, glm::vec3 &bboxMax);
+
+// Indices of the meshes reachable from the nodes of a scene, in increasing
+// order
+std::vector<int> computeSceneMeshes(const tinygltf::Model &model, int sceneIdx);
+
+// Indices of the bufferViews read by the vertex attributes and indices of all
+// the meshes, in increasing order
+std::vector<int> computeMeshBufferViews(const tinygltf::Model &model);
+
+// Content hash of each bufferView read by a mesh, 0 for other bufferViews, to
+// find the geometry that changed between two loadings of a file
+std::vector<uint64_t> computeBufferViewHashes(
+    const tinygltf::Model &model, const GltfBuffers &buffers);
@@ -0,0 +1,672 @@
+#include "gltf_loader.hpp"
+#include "base64.hpp"
+#include "parallel.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <json.hpp>
+#include <stdexcept>
+
+namespace
+{
+
+// https://github.com/KhronosGroup/glTF/tree/master/specification/2.0#glb-file-format-specification
+const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+const uint32_t GLB_VERSION = 2;
+const uint32_t GLB_CHUNK_TYPE_JSON = 0x4E4F534A; // "JSON"
+const uint32_t GLB_CHUNK_TYPE_BIN = 0x004E4942; // "BIN\0"
+const size_t GLB_HEADER_SIZE = 12;
+const size_t GLB_CHUNK_HEADER_SIZE = 8;
+
+// tinygltf rejects empty buffers and images, so the ones we provide the bytes
+// of (.glb BIN chunk, external files) are replaced by these 1 byte data URIs
+// while it parses the JSON
+const char *PLACEHOLDER_BUFFER_URI = "data:application/octet-stream;base64,AA==";
+const char *PLACEHOLDER_IMAGE_URI = "data:image/png;base64,AA==";
+
+uint32_t readUint32(const unsigned char *bytes)
+{
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+struct GlbChunks
+{
+  const unsigned char *json = nullptr;
+  size_t jsonSize = 0;
+  const unsigned char *bin = nullptr;
+  size_t binSize = 0;
+};
+
+bool isGlb(const MappedFile &file)
+{
+  return file.size() >= GLB_HEADER_SIZE && readUint32(file.data()) == GLB_MAGIC;
+}
+
+bool parseGlbChunks(
+    const unsigned char *bytes, size_t size, GlbChunks &chunks, std::string &err)
+{
+  const auto version = readUint32(bytes + 4);
+  const auto length = readUint32(bytes + 8);
+  if (version != GLB_VERSION) {
+    err += "Unsupported glTF binary version " + std::to_string(version) + "\n";
+    return false;
+  }
+  if (length > size) {
+    err += "Truncated glTF binary file\n";
+    return false;
+  }
+
+  size_t offset = GLB_HEADER_SIZE;
+  while (offset + GLB_CHUNK_HEADER_SIZE <= length) {
+    const auto chunkLength = readUint32(bytes + offset);
+    const auto chunkType = readUint32(bytes + offset + 4);
+    const auto chunkData = bytes + offset + GLB_CHUNK_HEADER_SIZE;
+    if (offset + GLB_CHUNK_HEADER_SIZE + chunkLength > length) {
+      err += "Invalid chunk length in glTF binary file\n";
+      return false;
+    }
+    if (chunkType == GLB_CHUNK_TYPE_JSON && !chunks.json) {
+      chunks.json = chunkData;
+      chunks.jsonSize = chunkLength;
+    } else if (chunkType == GLB_CHUNK_TYPE_BIN && !chunks.bin) {
+      chunks.bin = chunkData;
+      chunks.binSize = chunkLength;
+    } // Unknown chunks must be ignored
+    offset += GLB_CHUNK_HEADER_SIZE + chunkLength;
+  }
+
+  if (!chunks.json) {
+    err += "Missing JSON chunk in glTF binary file\n";
+    return false;
+  }
+  return true;
+}
+
+// Image whose bytes we provide instead of tinygltf
+struct ProvidedImage
+{
+  bool isProvided = false;
+  int bufferView = -1; // Set if stored in a provided buffer
+  std::vector<unsigned char> decodedBytes; // Set if stored in a data URI
+  std::string mimeType;
+};
+
+// Encoded image kept aside by tinygltf's image loader callback, to be decoded
+// once the whole JSON is parsed
+struct DeferredImage
+{
+  int imageIdx = -1;
+  int reqWidth = 0;
+  int reqHeight = 0;
+  const unsigned char *bytes = nullptr; // In ownedBytes or in a mapped buffer
+  int size = 0;
+  std::vector<unsigned char> ownedBytes;
+};
+
+struct LoaderContext
+{
+  // Model being filled by tinygltf, used to resolve image bufferViews
+  const tinygltf::Model *model = nullptr;
+  // Indexed like buffers, data is null for buffers loaded by tinygltf
+  std::vector<BufferBytes> providedBuffers;
+  // Indexed like buffers, bytes of buffers decoded from data URIs
+  std::vector<std::vector<unsigned char>> decodedBuffers;
+  // Indexed like images
+  std::vector<ProvidedImage> providedImages;
+  std::vector<DeferredImage> deferredImages;
+  GltfLoadProgress *progress = nullptr; // Optional
+  LoadReport *report = nullptr; // Optional
+};
+
+// Image loader callback given to tinygltf: it does not decode anything, images
+// are decoded in parallel by decodeDeferredImages() after parsing
+bool deferImageData(tinygltf::Image * /*image*/, const int imageIdx,
+    std::string *err, std::string * /*warn*/, int reqWidth, int reqHeight,
+    const unsigned char *bytes, int size, void *userData)
+{
+  auto &context = *static_cast<LoaderContext *>(userData);
+  DeferredImage deferred;
+  deferred.imageIdx = imageIdx;
+  deferred.reqWidth = reqWidth;
+  deferred.reqHeight = reqHeight;
+  auto *provided = size_t(imageIdx) < context.providedImages.size()
+                       ? &context.providedImages[imageIdx]
+                       : nullptr;
+  if (provided && provided->bufferView >= 0) {
+    // bytes are the placeholder, read the real ones from the provided buffer
+    const auto &bufferView = context.model->bufferViews[provided->bufferView];
+    const auto &buffer = context.providedBuffers[bufferView.buffer];
+    if (bufferView.byteOffset + bufferView.byteLength > buffer.size) {
+      if (err) {
+        (*err) += "image[" + std::to_string(imageIdx) +
+                  "] bufferView is out of buffer bounds\n";
+      }
+      return false;
+    }
+    deferred.bytes = buffer.data + bufferView.byteOffset;
+    deferred.size = int(bufferView.byteLength);
+  } else if (provided && provided->isProvided) {
+    // bytes are the placeholder, the real ones were decoded from a data URI
+    deferred.ownedBytes = std::move(provided->decodedBytes);
+    deferred.bytes = deferred.ownedBytes.data();
+    deferred.size = int(deferred.ownedBytes.size());
+  } else {
+    // bytes are owned by tinygltf and freed after this call
+    deferred.ownedBytes.assign(bytes, bytes + size);
+    deferred.bytes = deferred.ownedBytes.data();
+    deferred.size = size;
+  }
+  context.deferredImages.emplace_back(std::move(deferred));
+  return true;
+}
+
+bool decodeDeferredImages(tinygltf::Model &model, LoaderContext &context,
+    std::string &err, std::string &warn)
+{
+  const auto &deferredImages = context.deferredImages;
+  std::vector<std::string> errors(deferredImages.size());
+  std::vector<std::string> warnings(deferredImages.size());
+  std::vector<char> decoded(deferredImages.size(), false);
+  if (context.progress) {
+    context.progress->imageCount = deferredImages.size();
+  }
+
+  parallelFor(deferredImages.size(), [&](size_t i) {
+    const auto &deferred = deferredImages[i];
+    decoded[i] = tinygltf::LoadImageData(&model.images[deferred.imageIdx],
+        deferred.imageIdx, &errors[i], &warnings[i], deferred.reqWidth,
+        deferred.reqHeight, deferred.bytes, deferred.size, nullptr);
+    if (context.progress) {
+      ++context.progress->decodedImageCount;
+    }
+  });
+
+  auto success = true;
+  for (size_t i = 0; i < deferredImages.size(); ++i) {
+    err += errors[i];
+    warn += warnings[i];
+    success = success && decoded[i];
+  }
+  context.deferredImages.clear();
+  return success;
+}
+
+bool isDataUri(const std::string &uri) { return uri.compare(0, 5, "data:") == 0; }
+
+// Decode the base64 data URIs of buffers and images, in parallel, directly
+// into the storage they end up in. Data URIs that cannot be decoded here are
+// left to tinygltf, which reports the errors.
+void decodeDataUris(const nlohmann::json &document, LoaderContext &context)
+{
+  struct DataUri
+  {
+    const std::string *uri;
+    size_t payloadOffset;
+    size_t requiredSize; // 0 if any size is accepted
+    std::vector<unsigned char> *bytes;
+  };
+  std::vector<DataUri> dataUris;
+  const auto collectDataUris = [&](const char *arrayName, bool isBuffer) {
+    const auto array = document.find(arrayName);
+    if (array == document.end() || !array->is_array()) {
+      return;
+    }
+    for (size_t i = 0; i < array->size(); ++i) {
+      const auto &element = (*array)[i];
+      const auto uriIt = element.find("uri");
+      if (uriIt == element.end() || !uriIt->is_string()) {
+        continue;
+      }
+      const auto &uri = uriIt->get_ref<const std::string &>();
+      const auto base64Pos = uri.find(";base64,");
+      if (!isDataUri(uri) || base64Pos == std::string::npos) {
+        continue;
+      }
+      if (isBuffer) {
+        dataUris.emplace_back(DataUri{&uri, base64Pos + 8,
+            element.value("byteLength", size_t(0)),
+            &context.decodedBuffers[i]});
+      } else {
+        auto &provided = context.providedImages[i];
+        provided.mimeType = uri.substr(5, base64Pos - 5);
+        dataUris.emplace_back(
+            DataUri{&uri, base64Pos + 8, 0, &provided.decodedBytes});
+      }
+    }
+  };
+  collectDataUris("buffers", true);
+  collectDataUris("images", false);
+
+  parallelFor(dataUris.size(), [&](size_t i) {
+    const auto &dataUri = dataUris[i];
+    const auto payload = dataUri.uri->data() + dataUri.payloadOffset;
+    const auto payloadSize = dataUri.uri->size() - dataUri.payloadOffset;
+    const auto size = base64DecodedSize(payload, payloadSize);
+    if (size == 0 || (dataUri.requiredSize && size != dataUri.requiredSize)) {
+      return;
+    }
+    dataUri.bytes->resize(size);
+    if (!base64Decode(payload, payloadSize, dataUri.bytes->data())) {
+      std::vector<unsigned char>().swap(*dataUri.bytes);
+    }
+  });
+
+  for (size_t i = 0; i < context.decodedBuffers.size(); ++i) {
+    const auto &bytes = context.decodedBuffers[i];
+    if (!bytes.empty()) {
+      context.providedBuffers[i] = BufferBytes{bytes.data(), bytes.size()};
+    }
+  }
+  for (auto &provided : context.providedImages) {
+    provided.isProvided = !provided.decodedBytes.empty();
+  }
+}
+
+// Replace buffers we provide, and images stored in them, by placeholders
+void substituteProvidedData(nlohmann::json &document, LoaderContext &context)
+{
+  auto buffers = document.find("buffers");
+  if (buffers == document.end() || !buffers->is_array()) {
+    return;
+  }
+  for (size_t i = 0; i < context.providedBuffers.size(); ++i) {
+    if (context.providedBuffers[i].data) {
+      (*buffers)[i]["uri"] = PLACEHOLDER_BUFFER_URI;
+      (*buffers)[i]["byteLength"] = 1;
+    }
+  }
+
+  auto images = document.find("images");
+  auto bufferViews = document.find("bufferViews");
+  if (images == document.end() || !images->is_array()) {
+    return;
+  }
+  if (bufferViews == document.end() || !bufferViews->is_array()) {
+    bufferViews = document.end();
+  }
+  for (size_t i = 0; i < images->size(); ++i) {
+    auto &image = (*images)[i];
+    if (context.providedImages[i].isProvided) {
+      image["uri"] = PLACEHOLDER_IMAGE_URI; // Decoded from a data URI
+      continue;
+    }
+    const auto bufferViewIt = image.find("bufferView");
+    if (bufferViewIt == image.end() || !bufferViewIt->is_number_integer()) {
+      continue;
+    }
+    const auto bufferViewIdx = bufferViewIt->get<int>();
+    if (bufferViews == document.end() || bufferViewIdx < 0 ||
+        size_t(bufferViewIdx) >= bufferViews->size()) {
+      continue; // Let tinygltf report the error
+    }
+    const auto bufferIdx = (*bufferViews)[bufferViewIdx].value("buffer", -1);
+    if (bufferIdx < 0 ||
+        size_t(bufferIdx) >= context.providedBuffers.size() ||
+        !context.providedBuffers[bufferIdx].data) {
+      continue;
+    }
+    auto &provided = context.providedImages[i];
+    provided.isProvided = true;
+    provided.bufferView = bufferViewIdx;
+    provided.mimeType = image.value("mimeType", "");
+    image.erase("bufferView");
+    image.erase("mimeType");
+    image["uri"] = PLACEHOLDER_IMAGE_URI;
+  }
+}
+
+// Put back in the model what substituteProvidedData() replaced
+void restoreProvidedData(tinygltf::Model &model, LoaderContext &context)
+{
+  for (size_t i = 0; i < context.providedBuffers.size(); ++i) {
+    if (context.providedBuffers[i].data) {
+      model.buffers[i].uri.clear();
+      // Moving keeps providedBuffers[i] valid for decoded buffers
+      model.buffers[i].data = std::move(context.decodedBuffers[i]);
+    }
+  }
+  for (size_t i = 0; i < context.providedImages.size(); ++i) {
+    const auto &provided = context.providedImages[i];
+    if (provided.isProvided) {
+      model.images[i].bufferView = provided.bufferView;
+      model.images[i].mimeType = provided.mimeType;
+      model.images[i].uri.clear();
+    }
+  }
+}
+
+// Same lookup as tinygltf for external files: relative to the glTF file
+// directory first, then to the working directory. Empty if not found.
+std::string findExternalFile(const std::string &uri, const std::string &baseDir)
+{
+  for (const auto &dir : {baseDir, std::string(".")}) {
+    const auto path = tinygltf::ExpandFilePath(
+        dir.empty() ? uri : (fs::path(dir) / uri).string(), nullptr);
+    if (tinygltf::FileExists(path, nullptr)) {
+      return path;
+    }
+  }
+  return std::string();
+}
+
+// File system layer given to tinygltf. Files are read through memory mappings,
+// and external buffers are mapped once then viewed in place by GltfBuffers.
+class MappedFileSystem
+{
+  std::vector<MappedFile> &m_mappedFiles;
+  std::vector<std::string> m_mappedPaths; // Parallel to m_mappedFiles
+
+public:
+  MappedFileSystem(std::vector<MappedFile> &mappedFiles) :
+      m_mappedFiles(mappedFiles)
+  {
+  }
+
+  tinygltf::FsCallbacks callbacks()
+  {
+    return tinygltf::FsCallbacks{&tinygltf::FileExists,
+        &tinygltf::ExpandFilePath, &readWholeFile, &tinygltf::WriteWholeFile,
+        this};
+  }
+
+  // ReadWholeFile callback, userData is the MappedFileSystem. Files tinygltf
+  // reads, such as images, are copied from their existing mapping if they
+  // were mapped as buffers, from a mapping released right after otherwise.
+  static bool readWholeFile(std::vector<unsigned char> *out, std::string *err,
+      const std::string &filepath, void *userData)
+  {
+    const auto &fileSystem = *static_cast<MappedFileSystem *>(userData);
+    try {
+      if (const auto *mappedFile = fileSystem.find(filepath)) {
+        out->assign(
+            mappedFile->data(), mappedFile->data() + mappedFile->size());
+      } else {
+        const MappedFile file(filepath);
+        out->assign(file.data(), file.data() + file.size());
+      }
+    } catch (const std::runtime_error &e) {
+      if (err) {
+        (*err) += std::string(e.what()) + "\n";
+      }
+      return false;
+    }
+    return true;
+  }
+
+  // Existing mapping of a file, nullptr if it is not mapped
+  const MappedFile *find(const std::string &path) const
+  {
+    for (size_t i = 0; i < m_mappedPaths.size(); ++i) {
+      if (m_mappedPaths[i] == path) {
+        return &m_mappedFiles[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // Map a file, or return the existing mapping if it was already mapped.
+  // Throws std::runtime_error on failure.
+  const MappedFile &map(const std::string &path)
+  {
+    if (const auto *file = find(path)) {
+      return *file;
+    }
+    m_mappedFiles.emplace_back(path);
+    m_mappedPaths.emplace_back(path);
+    return m_mappedFiles.back();
+  }
+};
+
+// Map external buffer files so that tinygltf does not read them
+bool mapExternalBuffers(const nlohmann::json &document,
+    const std::string &baseDir, MappedFileSystem &fileSystem,
+    LoaderContext &context, std::string &err)
+{
+  const auto jsonBuffers = document.find("buffers");
+  if (jsonBuffers == document.end() || !jsonBuffers->is_array()) {
+    return true;
+  }
+  for (size_t i = 0; i < jsonBuffers->size(); ++i) {
+    const auto &jsonBuffer = (*jsonBuffers)[i];
+    const auto uri = jsonBuffer.value("uri", "");
+    if (uri.empty() || isDataUri(uri)) {
+      continue;
+    }
+    const auto path = findExternalFile(uri, baseDir);
+    if (path.empty()) {
+      err += "File not found : " + uri + "\n";
+      return false;
+    }
+    const auto byteLength = jsonBuffer.value("byteLength", size_t(0));
+    try {
+      const auto &file = fileSystem.map(path);
+      if (file.size() < byteLength) {
+        err += "File size mismatch : " + path + ", requestedBytes " +
+               std::to_string(byteLength) + ", but got " +
+               std::to_string(file.size()) + "\n";
+        return false;
+      }
+      context.providedBuffers[i] = BufferBytes{file.data(), byteLength};
+    } catch (const std::runtime_error &e) {
+      err += std::string(e.what()) + "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool loadDocument(nlohmann::json &document, const std::string &baseDir,
+    MappedFileSystem &fileSystem, LoaderContext &context,
+    tinygltf::Model &model, GltfBuffers &buffers, std::string &err,
+    std::string &warn)
+{
+  {
+    ScopedPhaseTimer timer(context.report, "gltf.mapBuffers");
+    if (!mapExternalBuffers(document, baseDir, fileSystem, context, err)) {
+      return false;
+    }
+  }
+  {
+    ScopedPhaseTimer timer(context.report, "gltf.decodeDataUris");
+    decodeDataUris(document, context);
+  }
+  substituteProvidedData(document, context);
+
+  {
+    // Includes reading external images, their decoding is deferred
+    ScopedPhaseTimer timer(context.report, "gltf.tinygltf");
+    tinygltf::TinyGLTF loader;
+    loader.SetFsCallbacks(fileSystem.callbacks());
+    loader.SetImageLoader(deferImageData, &context);
+    context.model = &model;
+    const auto json = document.dump();
+    if (!loader.LoadASCIIFromString(&model, &err, &warn, json.c_str(),
+            static_cast<unsigned int>(json.size()), baseDir)) {
+      return false;
+    }
+    restoreProvidedData(model, context);
+  }
+  {
+    ScopedPhaseTimer timer(context.report, "gltf.decodeImages");
+    if (!decodeDeferredImages(model, context, err, warn)) {
+      return false;
+    }
+  }
+
+  buffers.bytes.resize(model.buffers.size());
+  for (size_t i = 0; i < model.buffers.size(); ++i) {
+    buffers.bytes[i] = context.providedBuffers[i].data
+                           ? context.providedBuffers[i]
+                           : BufferBytes{model.buffers[i].data.data(),
+                                 model.buffers[i].data.size()};
+  }
+  return true;
+}
+
+LoaderContext makeLoaderContext(const nlohmann::json &document)
+{
+  LoaderContext context;
+  const auto jsonBuffers = document.find("buffers");
+  if (jsonBuffers != document.end() && jsonBuffers->is_array()) {
+    context.providedBuffers.resize(jsonBuffers->size());
+    context.decodedBuffers.resize(jsonBuffers->size());
+  }
+  const auto jsonImages = document.find("images");
+  if (jsonImages != document.end() && jsonImages->is_array()) {
+    context.providedImages.resize(jsonImages->size());
+  }
+  return context;
+}
+
+// Parse the JSON of a .gltf file, or of the JSON chunk of a .glb file. chunks
+// is only filled for .glb files.
+bool parseDocument(const fs::path &path, const MappedFile &file,
+    nlohmann::json &document, GlbChunks &chunks, std::string &err)
+{
+  if (isGlb(file)) {
+    if (!parseGlbChunks(file.data(), file.size(), chunks, err)) {
+      return false;
+    }
+    document = nlohmann::json::parse(
+        chunks.json, chunks.json + chunks.jsonSize, nullptr, false);
+  } else {
+    document = nlohmann::json::parse(
+        file.data(), file.data() + file.size(), nullptr, false);
+  }
+  if (document.is_discarded() || !document.is_object()) {
+    err += "Unable to parse JSON of " + path.string() + "\n";
+    return false;
+  }
+  return true;
+}
+
+bool loadFile(const fs::path &path, const MappedFile &file,
+    tinygltf::Model &model, GltfBuffers &buffers, std::string &err,
+    std::string &warn, GltfLoadProgress *progress, LoadReport *report)
+{
+  nlohmann::json document;
+  GlbChunks chunks;
+  {
+    ScopedPhaseTimer timer(report, "gltf.parseJson");
+    if (!parseDocument(path, file, document, chunks, err)) {
+      return false;
+    }
+  }
+
+  auto context = makeLoaderContext(document);
+  context.progress = progress;
+  context.report = report;
+  // Only the first buffer of a .glb can refer to the BIN chunk, by having no
+  // uri
+  if (chunks.bin && !context.providedBuffers.empty() &&
+      !document["buffers"][0].count("uri")) {
+    const auto byteLength =
+        document["buffers"][0].value("byteLength", size_t(0));
+    if (byteLength > chunks.binSize) {
+      err += "Invalid byteLength for buffer stored in BIN chunk\n";
+      return false;
+    }
+    context.providedBuffers[0] = BufferBytes{chunks.bin, byteLength};
+  }
+
+  MappedFileSystem fileSystem(buffers.mappedFiles);
+  return loadDocument(document, path.parent_path().string(), fileSystem,
+      context, model, buffers, err, warn);
+}
+
+} // namespace
+
+bool loadGltfModel(const fs::path &path, tinygltf::Model &model,
+    GltfBuffers &buffers, std::string &err, std::string &warn,
+    GltfLoadProgress *progress, LoadReport *report)
+{
+  MappedFile file;
+  try {
+    ScopedPhaseTimer timer(report, "gltf.mapFile");
+    file = MappedFile(path);
+  } catch (const std::runtime_error &e) {
+    err += std::string(e.what()) + "\n";
+    return false;
+  }
+
+  buffers = GltfBuffers{};
+  if (!loadFile(path, file, model, buffers, err, warn, progress, report)) {
+    return false;
+  }
+  if (isGlb(file)) {
+    // The BIN chunk is read from the mapping until the buffers are released
+    buffers.mappedFiles.emplace_back(std::move(file));
+  }
+  return true;
+}
+
+bool listGltfFiles(
+    const fs::path &path, std::vector<std::string> &files, std::string &err)
+{
+  nlohmann::json document;
+  GlbChunks chunks;
+  try {
+    const MappedFile file(path);
+    if (!parseDocument(path, file, document, chunks, err)) {
+      return false;
+    }
+  } catch (const std::runtime_error &e) {
+    err += std::string(e.what()) + "\n";
+    return false;
+  }
+
+  files.assign(1, path.string());
+  const auto baseDir = path.parent_path().string();
+  for (const auto &arrayName : {"buffers", "images"}) {
+    const auto array = document.find(arrayName);
+    if (array == document.end() || !array->is_array()) {
+      continue;
+    }
+    for (const auto &element : *array) {
+      const auto uri = element.value("uri", "");
+      if (uri.empty() || isDataUri(uri)) {
+        continue;
+      }
+      const auto filePath = findExternalFile(uri, baseDir);
+      if (filePath.empty()) {
+        err += "File not found : " + uri + "\n";
+        return false;
+      }
+      files.emplace_back(filePath);
+    }
+  }
+  return true;
+}
+
+size_t computeHostByteCount(
+    const tinygltf::Model &model, const GltfBuffers &buffers)
+{
+  size_t byteCount = 0;
+  for (const auto &buffer : model.buffers) {
+    byteCount += buffer.data.capacity();
+  }
+  for (const auto &file : buffers.mappedFiles) {
+    byteCount += file.size();
+  }
+  for (const auto &image : model.images) {
+    byteCount += image.image.capacity();
+  }
+  return byteCount;
+}
+
+void releaseHostData(tinygltf::Model &model, GltfBuffers &buffers)
+{
+  // Swapped with empty vectors, clear() would keep the capacity
+  for (auto &buffer : model.buffers) {
+    std::vector<unsigned char>().swap(buffer.data);
+  }
+  for (auto &image : model.images) {
+    std::vector<unsigned char>().swap(image.image);
+  }
+  buffers.mappedFiles.clear();
+  for (auto &bytes : buffers.bytes) {
+    bytes = BufferBytes{};
+  }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "load_report.hpp"
+#include "mapped_file.hpp"
+
+#include <atomic>
+#include <string>
+#include <tiny_gltf.h>
+#include <vector>
+
+// Non-owning view on the bytes of a glTF buffer
+struct BufferBytes
+{
+  const unsigned char *data = nullptr;
+  size_t size = 0;
+};
+
+// Bytes of every buffer of a tinygltf::Model. Buffers decoded by tinygltf (data
+// URIs) are viewed in tinygltf::Buffer::data, buffers stored in the BIN chunk
+// of a .glb file or in external files are viewed directly in the memory mapped
+// file, without any copy.
+struct GltfBuffers
+{
+  std::vector<BufferBytes> bytes; // Indexed like tinygltf::Model::buffers
+  std::vector<MappedFile> mappedFiles; // Memory pointed by some of bytes
+};
+
+// Progress of a loadGltfModel() call, can be read from another thread
+struct GltfLoadProgress
+{
+  std::atomic<size_t> imageCount{0}; // Known once the JSON is parsed
+  std::atomic<size_t> decodedImageCount{0};
+};
+
+// Load a .gltf or .glb file (detected from its content, not its extension).
+// Buffer bytes must be read from buffers, not from model.buffers[i].data which
+// is empty for memory mapped buffers. Images are decoded in parallel once the
+// JSON is parsed. Errors and warnings are appended to err and warn. The
+// duration of each loading phase is added to report, if not null.
+bool loadGltfModel(const fs::path &path, tinygltf::Model &model,
+    GltfBuffers &buffers, std::string &err, std::string &warn,
+    GltfLoadProgress *progress = nullptr, LoadReport *report = nullptr);
+
+// Paths of the files loadGltfModel() reads for a glTF file: the file itself,
+// then its external buffers and images
+bool listGltfFiles(
+    const fs::path &path, std::vector<std::string> &files, std::string &err);
+
+// Bytes of a model held in host memory: buffers decoded in memory, memory
+// mapped files (counted whole, even if some pages are not resident) and
+// decoded images
+size_t computeHostByteCount(
+    const tinygltf::Model &model, const GltfBuffers &buffers);
+
+// Free the bytes of the buffers and the pixels of the images, keeping all the
+// metadata (accessors, bufferViews, meshes, nodes, image sizes...). buffers
+// then views no byte.
+void releaseHostData(tinygltf::Model &model, GltfBuffers &buffers);
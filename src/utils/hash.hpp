@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64 bits non cryptographic hash of a byte range (XXH64 algorithm,
+// https://github.com/Cyan4973/xxHash), fast enough to hash multi-GB files
+uint64_t hash64(const void *data, size_t size, uint64_t seed = 0);
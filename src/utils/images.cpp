@@ -1,4 +1,5 @@
 #include "images.hpp"
+#include "gl_objects.hpp"
 
 #include <cassert>
 #include <glad/glad.h>
@@ -14,40 +15,29 @@ void renderToImage(size_t width, size_t height, size_t numComponents,
   glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextureObject);
   glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebufferObject);
 
-  GLuint textureObject = 0;
-
-  glGenTextures(1, &textureObject);
-
-  glBindTexture(GL_TEXTURE_2D, textureObject);
-
   // Lets avoid warnings
   const auto w = GLsizei(width);
   const auto h = GLsizei(height);
 
+  // Textures and framebuffer are deleted on return
+
   // if we want better quality, we can use multisampling, but for testing
   // purpose it is useless todo replace with glTexStorage2DMultisample (in that
   // case need to todo glBlitFramebuffer in another one in order to be able to
   // glGetTexImage)
   // https://stackoverflow.com/questions/14019910/how-does-glteximage2dmultisample-work
-  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, w, h);
-
-  GLuint depthTexture;
-  glGenTextures(1, &depthTexture);
-
-  glBindTexture(GL_TEXTURE_2D, depthTexture);
-
-  glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, w, h);
+  const auto texture = createTexture2D(GL_RGBA32F, w, h);
+  const auto depthTexture = createTexture2D(GL_DEPTH_COMPONENT32F, w, h);
 
-  glBindTexture(GL_TEXTURE_2D, previousTextureObject);
+  glBindTexture(GL_TEXTURE_2D, GLuint(previousTextureObject));
 
-  GLuint framebufferObject = 0;
-  glGenFramebuffers(1, &framebufferObject);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebufferObject);
+  const auto framebuffer = GLFramebuffer::generate();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer.glId());
 
   glFramebufferTexture(
-      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureObject, 0);
+      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture.glId(), 0);
   glFramebufferTexture(
-      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture.glId(), 0);
 
   GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
   glDrawBuffers(1, drawBuffers);
@@ -59,7 +49,7 @@ void renderToImage(size_t width, size_t height, size_t numComponents,
 
   GLint currentlyBoundFBO = 0;
   glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &currentlyBoundFBO);
-  if (currentlyBoundFBO != framebufferObject) {
+  if (GLuint(currentlyBoundFBO) != framebuffer.glId()) {
     // Display a warning on clog
     // It may not be an error because the drawScene() function might have render
     // to the framebuffer but unbound it after.
@@ -69,10 +59,10 @@ void renderToImage(size_t width, size_t height, size_t numComponents,
         << std::endl;
   }
 
-  glBindTexture(GL_TEXTURE_2D, textureObject);
+  glBindTexture(GL_TEXTURE_2D, texture.glId());
   glGetTexImage(GL_TEXTURE_2D, 0, numComponents == 3 ? GL_RGB : GL_RGBA,
       GL_UNSIGNED_BYTE, outPixels);
 
-  glBindTexture(GL_TEXTURE_2D, previousTextureObject);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebufferObject);
+  glBindTexture(GL_TEXTURE_2D, GLuint(previousTextureObject));
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousFramebufferObject));
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "load_report.hpp"
+
+#include <fstream>
+#include <json.hpp>
+
+void LoadReport::addPhase(const std::string &name, double seconds)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto &phase : m_phaseSeconds) {
+    if (phase.first == name) {
+      phase.second += seconds;
+      return;
+    }
+  }
+  m_phaseSeconds.emplace_back(name, seconds);
+}
+
+void LoadReport::setCount(const std::string &name, size_t count)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto &counter : m_counts) {
+    if (counter.first == name) {
+      counter.second = count;
+      return;
+    }
+  }
+  m_counts.emplace_back(name, count);
+}
+
+bool LoadReport::write(const fs::path &path, std::string &err) const
+{
+  // Phases are an array to keep their order, JSON objects are sorted by key
+  auto phases = nlohmann::json::array();
+  auto counts = nlohmann::json::object();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto &phase : m_phaseSeconds) {
+      phases.push_back({{"name", phase.first}, {"seconds", phase.second}});
+    }
+    for (const auto &counter : m_counts) {
+      counts[counter.first] = counter.second;
+    }
+  }
+  const nlohmann::json report = {{"phases", phases}, {"counts", counts}};
+
+  std::ofstream out(path.string());
+  out << report.dump(2) << std::endl;
+  if (!out) {
+    err += "Unable to write load report " + path.string() + "\n";
+    return false;
+  }
+  return true;
+}
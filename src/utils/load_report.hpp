@@ -0,0 +1,58 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Durations of the phases of loading a scene and sizes of what was loaded,
+// written as JSON for tools tracking loading performance. Phases and counts
+// can be added from any thread.
+class LoadReport
+{
+  mutable std::mutex m_mutex;
+  // In order of first addition
+  std::vector<std::pair<std::string, double>> m_phaseSeconds;
+  std::vector<std::pair<std::string, size_t>> m_counts;
+
+public:
+  // Adding a phase several times sums its durations
+  void addPhase(const std::string &name, double seconds);
+
+  void setCount(const std::string &name, size_t count);
+
+  bool write(const fs::path &path, std::string &err) const;
+};
+
+// Time the scope in which it is declared as a phase of report, if not null
+class ScopedPhaseTimer
+{
+  LoadReport *m_pReport;
+  std::string m_name;
+  std::chrono::steady_clock::time_point m_start;
+
+public:
+  ScopedPhaseTimer(LoadReport *report, std::string name) :
+      m_pReport(report),
+      m_name(std::move(name)),
+      m_start(std::chrono::steady_clock::now())
+  {
+  }
+
+  ~ScopedPhaseTimer()
+  {
+    if (m_pReport) {
+      const auto elapsed = std::chrono::steady_clock::now() - m_start;
+      m_pReport->addPhase(
+          m_name, std::chrono::duration<double>(elapsed).count());
+    }
+  }
+
+  ScopedPhaseTimer(const ScopedPhaseTimer &) = delete;
+
+  ScopedPhaseTimer &operator=(const ScopedPhaseTimer &) = delete;
+};
@@ -0,0 +1,148 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const fs::path &path)
+{
+#ifdef _WIN32
+  const auto hFile = CreateFileW(path.wstring().c_str(), GENERIC_READ,
+      FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (hFile == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Unable to open file " + path.string());
+  }
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(hFile, &fileSize)) {
+    CloseHandle(hFile);
+    throw std::runtime_error("Unable to get size of file " + path.string());
+  }
+  m_hFile = hFile;
+  m_nSize = size_t(fileSize.QuadPart);
+  if (m_nSize == 0) {
+    // Empty files cannot be mapped, but they are still valid files
+    return;
+  }
+  m_hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_hMapping) {
+    release();
+    throw std::runtime_error("Unable to map file " + path.string());
+  }
+  m_pData = static_cast<const unsigned char *>(
+      MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+  if (!m_pData) {
+    release();
+    throw std::runtime_error("Unable to map file " + path.string());
+  }
+#else
+  const auto fd = open(path.string().c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open file " + path.string());
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    close(fd);
+    throw std::runtime_error("Unable to get size of file " + path.string());
+  }
+  m_nSize = size_t(fileStat.st_size);
+  if (m_nSize == 0) {
+    // Empty files cannot be mapped, but they are still valid files
+    close(fd);
+    return;
+  }
+  auto *pData = mmap(nullptr, m_nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file
+  close(fd);
+  if (pData == MAP_FAILED) {
+    m_nSize = 0;
+    throw std::runtime_error("Unable to map file " + path.string());
+  }
+  m_pData = static_cast<const unsigned char *>(pData);
+#endif
+}
+
+MappedFile::~MappedFile() { release(); }
+
+MappedFile::MappedFile(MappedFile &&rvalue) noexcept :
+    m_pData(rvalue.m_pData),
+    m_nSize(rvalue.m_nSize)
+#ifdef _WIN32
+    ,
+    m_hFile(rvalue.m_hFile),
+    m_hMapping(rvalue.m_hMapping)
+#endif
+{
+  rvalue.m_pData = nullptr;
+  rvalue.m_nSize = 0;
+#ifdef _WIN32
+  rvalue.m_hFile = nullptr;
+  rvalue.m_hMapping = nullptr;
+#endif
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rvalue) noexcept
+{
+  if (this != &rvalue) {
+    release();
+    std::swap(m_pData, rvalue.m_pData);
+    std::swap(m_nSize, rvalue.m_nSize);
+#ifdef _WIN32
+    std::swap(m_hFile, rvalue.m_hFile);
+    std::swap(m_hMapping, rvalue.m_hMapping);
+#endif
+  }
+  return *this;
+}
+
+void MappedFile::releasePages(const unsigned char *p, size_t size) const
+{
+  if (!contains(p)) {
+    return;
+  }
+  size = std::min(size, size_t(m_pData + m_nSize - p));
+#ifdef _WIN32
+  // Unlocking pages that are not locked removes them from the working set
+  VirtualUnlock(const_cast<unsigned char *>(p), size);
+#else
+  // Pages partially in the range are released too, the mapping is read-only
+  // so they are read back unchanged if needed
+  const auto pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+  const auto begin = uintptr_t(p) & ~(pageSize - 1);
+  const auto end = uintptr_t(p + size);
+  madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+#endif
+}
+
+void MappedFile::release()
+{
+#ifdef _WIN32
+  if (m_pData) {
+    UnmapViewOfFile(m_pData);
+  }
+  if (m_hMapping) {
+    CloseHandle(m_hMapping);
+  }
+  if (m_hFile) {
+    CloseHandle(m_hFile);
+  }
+  m_hFile = nullptr;
+  m_hMapping = nullptr;
+#else
+  if (m_pData) {
+    munmap(const_cast<unsigned char *>(m_pData), m_nSize);
+  }
+#endif
+  m_pData = nullptr;
+  m_nSize = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The mapping is released in the
+// destructor, so pointers obtained with data() must not outlive the object.
+class MappedFile
+{
+  const unsigned char *m_pData = nullptr;
+  size_t m_nSize = 0;
+#ifdef _WIN32
+  void *m_hFile = nullptr;
+  void *m_hMapping = nullptr;
+#endif
+
+public:
+  MappedFile() = default;
+
+  // Throws std::runtime_error if the file cannot be opened or mapped
+  explicit MappedFile(const fs::path &path);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&rvalue) noexcept;
+
+  MappedFile &operator=(MappedFile &&rvalue) noexcept;
+
+  const unsigned char *data() const { return m_pData; }
+
+  size_t size() const { return m_nSize; }
+
+  bool empty() const { return m_nSize == 0; }
+
+  bool contains(const unsigned char *p) const
+  {
+    return m_pData && p >= m_pData && p < m_pData + m_nSize;
+  }
+
+  // Drop the pages of [p, p + size) from the memory of the process, they are
+  // read again from the file if accessed later. Used to stream large files
+  // with bounded memory.
+  void releasePages(const unsigned char *p, size_t size) const;
+
+private:
+  void release();
+};
@@ -0,0 +1,1572 @@
+#include "mesh_optimizer.hpp"
+#include "geometry_arena.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+// Scores of Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+// View directions optimizeOverdraw() orders clusters for, evenly spread on
+// the unit sphere
+const size_t OVERDRAW_VIEW_DIRECTION_COUNT = 16;
+
+// Vertices in the cache are likely to be reused soon, and vertices with few
+// remaining triangles should be finished before they are evicted
+float computeVertexScore(int cachePosition, uint32_t remainingTriangleCount)
+{
+  if (remainingTriangleCount == 0) {
+    return -1.f;
+  }
+  auto score = 0.f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // Vertices of the last triangle, slightly penalized so that strips of
+      // triangles are not favored over fans
+      score = LAST_TRIANGLE_SCORE;
+    } else {
+      const auto scale = 1.f / (VERTEX_CACHE_SIZE - 3);
+      score = std::pow(
+          1.f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+    }
+  }
+  return score + VALENCE_BOOST_SCALE *
+                     std::pow(float(remainingTriangleCount),
+                         -VALENCE_BOOST_POWER);
+}
+
+struct TriangleIndexAccessor
+{
+  int indices = -1;
+  // Of the first primitive drawing the triangles, -1 if it cannot be read
+  int positions = -1;
+};
+
+// Index accessors of the TRIANGLES primitives of the model
+std::vector<TriangleIndexAccessor> findTriangleIndexAccessors(
+    const tinygltf::Model &model, const GltfBuffers &buffers)
+{
+  std::vector<TriangleIndexAccessor> accessors;
+  std::vector<bool> isFound(model.accessors.size(), false);
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      if (primitive.mode == TINYGLTF_MODE_TRIANGLES &&
+          isIndicesReadable(model, buffers, primitive.indices) &&
+          !isFound[primitive.indices]) {
+        isFound[primitive.indices] = true;
+        TriangleIndexAccessor accessor;
+        accessor.indices = primitive.indices;
+        const auto it = primitive.attributes.find("POSITION");
+        if (it != end(primitive.attributes) &&
+            isVertexAttribReadable(
+                model, buffers, it->second, VERTEX_ATTRIB_POSITION)) {
+          accessor.positions = it->second;
+        }
+        accessors.emplace_back(accessor);
+      }
+    }
+  }
+  return accessors;
+}
+
+// First triangle of each cluster of consecutive triangles, followed by
+// triangleCount
+std::vector<size_t> splitTriangleClusters(const uint32_t *indices,
+    size_t triangleCount, size_t vertexCount, float acmrThreshold)
+{
+  // Same FIFO cache as countVertexCacheMisses(), emptied by moving time
+  // forward
+  const auto cacheSize = MEASURED_VERTEX_CACHE_SIZE;
+  std::vector<size_t> entryTimes(vertexCount, 0);
+  auto time = cacheSize + 1;
+  const auto countMisses = [&](size_t triangle) {
+    size_t missCount = 0;
+    for (size_t k = 0; k < 3; ++k) {
+      const auto vertex = indices[3 * triangle + k];
+      if (time - entryTimes[vertex] > cacheSize) {
+        entryTimes[vertex] = time++;
+        ++missCount;
+      }
+    }
+    return missCount;
+  };
+
+  // Hard boundaries are triangles missing the cache on all of their
+  // vertices, where the vertex cache optimization started again from
+  // scratch: reordering clusters there costs nothing
+  std::vector<size_t> hardBoundaries;
+  size_t meshMissCount = 0;
+  for (size_t t = 0; t < triangleCount; ++t) {
+    const auto missCount = countMisses(t);
+    if (t == 0 || missCount == 3) {
+      hardBoundaries.emplace_back(t);
+    }
+    meshMissCount += missCount;
+  }
+  hardBoundaries.emplace_back(triangleCount);
+  const auto maxACMR = acmrThreshold * float(meshMissCount) / triangleCount;
+
+  // Soft boundaries end a cluster as soon as its ACMR, drawn from an empty
+  // cache, is low enough, which bounds the ACMR of any order of the clusters
+  std::vector<size_t> clusters;
+  for (size_t i = 0; i + 1 < hardBoundaries.size(); ++i) {
+    auto first = hardBoundaries[i];
+    const auto last = hardBoundaries[i + 1];
+    clusters.emplace_back(first);
+    time += cacheSize + 1;
+    size_t missCount = 0;
+    for (auto t = first; t + 1 < last; ++t) {
+      missCount += countMisses(t);
+      if (float(missCount) <= maxACMR * float(t + 1 - first)) {
+        first = t + 1;
+        clusters.emplace_back(first);
+        time += cacheSize + 1;
+        missCount = 0;
+      }
+    }
+  }
+  clusters.emplace_back(triangleCount);
+  return clusters;
+}
+
+// Direction i of count directions evenly spread on the unit sphere, along a
+// Fibonacci spiral
+glm::vec3 getFibonacciDirection(size_t i, size_t count)
+{
+  const auto goldenAngle = glm::pi<float>() * (3.f - std::sqrt(5.f));
+  const auto z = 1.f - (2.f * i + 1.f) / count;
+  const auto radius = std::sqrt(std::max(0.f, 1.f - z * z));
+  const auto angle = goldenAngle * i;
+  return glm::vec3(radius * std::cos(angle), radius * std::sin(angle), z);
+}
+
+// Primitives renumbered together since they read the same vertex accessors
+struct VertexSet
+{
+  std::vector<int> vertexAccessors;
+  std::vector<int> indexAccessors;
+};
+
+// Accessors of the vertex attributes and morph targets of a primitive, sorted
+std::vector<int> getVertexAccessors(const tinygltf::Primitive &primitive)
+{
+  std::vector<int> accessors;
+  for (const auto &attribute : primitive.attributes) {
+    if (isVertexAttribute(attribute.first)) {
+      accessors.emplace_back(attribute.second);
+    }
+  }
+  for (const auto &target : primitive.targets) {
+    for (const auto &attribute : target) {
+      accessors.emplace_back(attribute.second);
+    }
+  }
+  std::sort(begin(accessors), end(accessors));
+  accessors.erase(
+      std::unique(begin(accessors), end(accessors)), end(accessors));
+  return accessors;
+}
+
+// Vertex accessors, and indices, of a vertex set once renumbered
+struct RenumberedVertexSet
+{
+  bool isRenumbered = false;
+  size_t vertexCount = 0;
+  // Elements of each vertex accessor, byteStrides[i] bytes apart. Empty for
+  // accessors without bufferView.
+  std::vector<std::vector<unsigned char>> vertexData;
+  std::vector<size_t> byteStrides;
+  // Indices of index accessor i are [firstIndices[i], firstIndices[i + 1])
+  std::vector<uint32_t> indices;
+  std::vector<size_t> firstIndices;
+  VertexFetchStatistics statistics;
+};
+
+RenumberedVertexSet renumberVertexSet(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const VertexSet &set)
+{
+  RenumberedVertexSet renumbered;
+  auto vertexCount = std::numeric_limits<size_t>::max();
+  size_t vertexByteSize = 0;
+  for (const auto accessorIdx : set.vertexAccessors) {
+    if (!isAccessorReadable(model, buffers, accessorIdx) ||
+        model.accessors[accessorIdx].sparse.isSparse) {
+      return renumbered;
+    }
+    const auto &accessor = model.accessors[accessorIdx];
+    vertexCount = std::min(vertexCount, accessor.count);
+    vertexByteSize += getElementByteSize(accessor);
+  }
+  if (set.vertexAccessors.empty()) {
+    return renumbered;
+  }
+  auto &indices = renumbered.indices;
+  for (const auto accessorIdx : set.indexAccessors) {
+    const auto count = model.accessors[accessorIdx].count;
+    renumbered.firstIndices.emplace_back(indices.size());
+    indices.resize(indices.size() + count);
+    readIndices(model, buffers, accessorIdx, 0, count,
+        indices.data() + renumbered.firstIndices.back());
+  }
+  renumbered.firstIndices.emplace_back(indices.size());
+  if (indices.empty() ||
+      *std::max_element(begin(indices), end(indices)) >= vertexCount) {
+    return renumbered;
+  }
+
+  auto &statistics = renumbered.statistics;
+  statistics.vertexCount = vertexCount;
+  statistics.fetchedByteCountBefore = countVertexFetchBytes(
+      indices.data(), indices.size(), vertexCount, vertexByteSize);
+  std::vector<uint32_t> remap(vertexCount);
+  renumbered.vertexCount = optimizeVertexFetch(
+      indices.data(), indices.size(), vertexCount, remap.data());
+  statistics.usedVertexCount = renumbered.vertexCount;
+  statistics.usedByteCount = renumbered.vertexCount * vertexByteSize;
+  statistics.fetchedByteCountAfter = countVertexFetchBytes(
+      indices.data(), indices.size(), renumbered.vertexCount, vertexByteSize);
+
+  for (const auto accessorIdx : set.vertexAccessors) {
+    const auto &accessor = model.accessors[accessorIdx];
+    const auto elementByteSize = getElementByteSize(accessor);
+    // glTF requires elements of vertex attributes to be aligned to 4 bytes
+    const auto byteStride = (elementByteSize + 3) & ~size_t(3);
+    renumbered.byteStrides.emplace_back(byteStride);
+    renumbered.vertexData.emplace_back();
+    const auto bytes =
+        getAccessorBytes(model, buffers, accessorIdx, 0, vertexCount);
+    if (!bytes.data) {
+      continue;
+    }
+    const auto srcByteStride =
+        size_t(accessor.ByteStride(model.bufferViews[accessor.bufferView]));
+    auto &data = renumbered.vertexData.back();
+    data.resize(renumbered.vertexCount * byteStride, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+      if (remap[v] != UNUSED_VERTEX) {
+        std::memcpy(data.data() + remap[v] * byteStride,
+            bytes.data + v * srcByteStride, elementByteSize);
+      }
+    }
+  }
+  renumbered.isRenumbered = true;
+  return renumbered;
+}
+
+// Bounding sphere and normal cone of the triangles of a meshlet
+void computeMeshletBounds(Meshlet &meshlet, const uint32_t *indices,
+    const float *positions, const std::vector<uint32_t> &meshletVertices)
+{
+  const auto position = [positions](uint32_t vertex) {
+    return glm::make_vec3(positions + 3 * size_t(vertex));
+  };
+  auto boundsMin = glm::vec3(std::numeric_limits<float>::max());
+  auto boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+  for (const auto vertex : meshletVertices) {
+    boundsMin = glm::min(boundsMin, position(vertex));
+    boundsMax = glm::max(boundsMax, position(vertex));
+  }
+  meshlet.center = 0.5f * (boundsMin + boundsMax);
+  meshlet.radius = 0.f;
+  for (const auto vertex : meshletVertices) {
+    meshlet.radius = std::max(
+        meshlet.radius, glm::distance(meshlet.center, position(vertex)));
+  }
+
+  // The axis is the average normal, the cone is as wide as the normal the
+  // furthest from it
+  const auto *triangles = indices + meshlet.firstIndex;
+  std::vector<glm::vec3> normals;
+  glm::vec3 normalSum(0.f);
+  for (size_t t = 0; t < meshlet.triangleCount; ++t) {
+    const auto a = position(triangles[3 * t]);
+    const auto normal = glm::cross(position(triangles[3 * t + 1]) - a,
+        position(triangles[3 * t + 2]) - a);
+    const auto length = glm::length(normal);
+    if (length > 0.f) {
+      normals.emplace_back(normal / length);
+      normalSum += normals.back();
+    }
+  }
+  const auto sumLength = glm::length(normalSum);
+  meshlet.coneAxis = sumLength > 0.f ? normalSum / sumLength : normalSum;
+  meshlet.coneCutoff = 1.f;
+  if (normals.empty() || sumLength == 0.f) {
+    return;
+  }
+  auto minDot = 1.f;
+  for (const auto &normal : normals) {
+    minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+  }
+  if (minDot > 0.f) {
+    meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+  }
+}
+
+// Sum of weighted squared distances to planes, x^T A x + 2 b.x + c with A
+// symmetric
+struct Quadric
+{
+  double a00 = 0., a11 = 0., a22 = 0., a01 = 0., a02 = 0., a12 = 0.;
+  double b0 = 0., b1 = 0., b2 = 0.;
+  double c = 0.;
+  double weight = 0.;
+};
+
+// Plane of points p such that dot(normal, p) + distance = 0
+void addPlane(Quadric &quadric, const glm::dvec3 &normal, double distance,
+    double weight)
+{
+  quadric.a00 += weight * normal.x * normal.x;
+  quadric.a11 += weight * normal.y * normal.y;
+  quadric.a22 += weight * normal.z * normal.z;
+  quadric.a01 += weight * normal.x * normal.y;
+  quadric.a02 += weight * normal.x * normal.z;
+  quadric.a12 += weight * normal.y * normal.z;
+  quadric.b0 += weight * normal.x * distance;
+  quadric.b1 += weight * normal.y * distance;
+  quadric.b2 += weight * normal.z * distance;
+  quadric.c += weight * distance * distance;
+  quadric.weight += weight;
+}
+
+void addQuadric(Quadric &quadric, const Quadric &other)
+{
+  quadric.a00 += other.a00;
+  quadric.a11 += other.a11;
+  quadric.a22 += other.a22;
+  quadric.a01 += other.a01;
+  quadric.a02 += other.a02;
+  quadric.a12 += other.a12;
+  quadric.b0 += other.b0;
+  quadric.b1 += other.b1;
+  quadric.b2 += other.b2;
+  quadric.c += other.c;
+  quadric.weight += other.weight;
+}
+
+// Weighted average of the squared distances of a point to the planes
+double evaluateQuadric(const Quadric &quadric, const glm::dvec3 &point)
+{
+  const auto x = point.x, y = point.y, z = point.z;
+  const auto value =
+      quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z +
+      2. * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z) +
+      2. * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z) + quadric.c;
+  return quadric.weight > 0. ? std::abs(value) / quadric.weight : 0.;
+}
+
+// Borders and seams are weighted more than faces, so that their shape is kept
+const double BORDER_QUADRIC_WEIGHT = 2.;
+
+const uint32_t NO_VERTEX = ~uint32_t(0);
+
+enum VertexKind
+{
+  VERTEX_MANIFOLD, // Moves onto any neighbour
+  VERTEX_BORDER, // Moves along its border
+  VERTEX_SEAM, // Moves along its seam, with its wedge
+  VERTEX_LOCKED
+};
+
+struct VertexTopology
+{
+  std::vector<VertexKind> kinds;
+  // Next and previous vertices along the edges of a single triangle, on
+  // borders and on each side of attribute seams, in the order of triangles
+  std::vector<uint32_t> loops;
+  std::vector<uint32_t> loopbacks;
+  // Vertex at the same position as a seam vertex, on the other side of its
+  // seam
+  std::vector<uint32_t> wedges;
+  // First vertex at the position of each vertex
+  std::vector<uint32_t> positionVertices;
+};
+
+// Vertices of several borders or seams, of non-manifold edges, and at the
+// same position as more than one other vertex, are locked
+VertexTopology classifyVertices(const uint32_t *indices, size_t indexCount,
+    const std::vector<glm::vec3> &points)
+{
+  const auto vertexCount = points.size();
+  std::vector<uint32_t> usedVertices;
+  std::vector<bool> isUsed(vertexCount, false);
+  for (size_t i = 0; i < indexCount; ++i) {
+    if (!isUsed[indices[i]]) {
+      isUsed[indices[i]] = true;
+      usedVertices.emplace_back(indices[i]);
+    }
+  }
+  const auto isBefore = [&](uint32_t lhs, uint32_t rhs) {
+    const auto &a = points[lhs];
+    const auto &b = points[rhs];
+    return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+  };
+  std::sort(begin(usedVertices), end(usedVertices), isBefore);
+  VertexTopology topology;
+  auto &positionVertices = topology.positionVertices;
+  positionVertices.assign(vertexCount, NO_VERTEX);
+  std::vector<uint32_t> wedgeCounts(vertexCount, 0);
+  for (size_t i = 0; i < usedVertices.size(); ++i) {
+    const auto vertex = usedVertices[i];
+    const auto isSamePosition =
+        i > 0 && points[usedVertices[i - 1]] == points[vertex];
+    positionVertices[vertex] =
+        isSamePosition ? positionVertices[usedVertices[i - 1]] : vertex;
+    ++wedgeCounts[positionVertices[vertex]];
+  }
+
+  // An edge of a single triangle is on a border if the edge between its
+  // positions is too, and on a seam otherwise
+  const auto getEdgeKey = [](uint32_t a, uint32_t b) {
+    return (uint64_t(a) << 32) | b;
+  };
+  std::unordered_map<uint64_t, uint32_t> edgeCounts;
+  std::unordered_map<uint64_t, uint32_t> positionEdgeCounts;
+  for (size_t i = 0; i < indexCount; ++i) {
+    const auto a = indices[i];
+    const auto b = indices[i % 3 == 2 ? i - 2 : i + 1];
+    ++edgeCounts[getEdgeKey(a, b)];
+    ++positionEdgeCounts[getEdgeKey(positionVertices[a], positionVertices[b])];
+  }
+  const auto getCount = [](const std::unordered_map<uint64_t, uint32_t> &counts,
+                            uint64_t key) {
+    const auto it = counts.find(key);
+    return it == end(counts) ? 0u : it->second;
+  };
+  auto &loops = topology.loops;
+  auto &loopbacks = topology.loopbacks;
+  loops.assign(vertexCount, NO_VERTEX);
+  loopbacks.assign(vertexCount, NO_VERTEX);
+  std::vector<bool> isLocked(vertexCount, false);
+  std::vector<bool> isOnBorder(vertexCount, false);
+  for (size_t i = 0; i < indexCount; ++i) {
+    const auto a = indices[i];
+    const auto b = indices[i % 3 == 2 ? i - 2 : i + 1];
+    const auto positionA = positionVertices[a];
+    const auto positionB = positionVertices[b];
+    if (getCount(edgeCounts, getEdgeKey(a, b)) > 1 ||
+        getCount(edgeCounts, getEdgeKey(b, a)) > 1 ||
+        getCount(positionEdgeCounts, getEdgeKey(positionA, positionB)) > 1 ||
+        getCount(positionEdgeCounts, getEdgeKey(positionB, positionA)) > 1) {
+      isLocked[a] = isLocked[b] = true;
+      continue;
+    }
+    if (getCount(positionEdgeCounts, getEdgeKey(positionB, positionA)) == 0) {
+      isOnBorder[a] = isOnBorder[b] = true;
+    }
+    if (getCount(edgeCounts, getEdgeKey(b, a)) == 0) {
+      isLocked[a] = isLocked[a] || loops[a] != NO_VERTEX;
+      isLocked[b] = isLocked[b] || loopbacks[b] != NO_VERTEX;
+      loops[a] = b;
+      loopbacks[b] = a;
+    }
+  }
+
+  auto &kinds = topology.kinds;
+  kinds.assign(vertexCount, VERTEX_LOCKED);
+  topology.wedges.assign(vertexCount, NO_VERTEX);
+  for (size_t i = 0; i < usedVertices.size(); ++i) {
+    const auto vertex = usedVertices[i];
+    const auto isOpen =
+        loops[vertex] != NO_VERTEX || loopbacks[vertex] != NO_VERTEX;
+    const auto isOnLoop = loops[vertex] != NO_VERTEX &&
+                          loopbacks[vertex] != NO_VERTEX &&
+                          loops[vertex] != loopbacks[vertex];
+    const auto wedgeCount = wedgeCounts[positionVertices[vertex]];
+    if (isLocked[vertex]) {
+      continue;
+    }
+    if (wedgeCount == 1 && !isOpen) {
+      kinds[vertex] = VERTEX_MANIFOLD;
+    } else if (wedgeCount == 1 && isOnLoop && isOnBorder[vertex]) {
+      kinds[vertex] = VERTEX_BORDER;
+    } else if (wedgeCount == 2 && isOnLoop && !isOnBorder[vertex]) {
+      kinds[vertex] = VERTEX_SEAM;
+      topology.wedges[vertex] =
+          positionVertices[vertex] == vertex ? usedVertices[i + 1]
+                                             : usedVertices[i - 1];
+    }
+  }
+  // Both sides of a seam move together
+  for (const auto vertex : usedVertices) {
+    if (kinds[vertex] == VERTEX_SEAM &&
+        kinds[topology.wedges[vertex]] != VERTEX_SEAM) {
+      kinds[vertex] = VERTEX_LOCKED;
+    }
+  }
+  return topology;
+}
+
+// Remove triangles with two corners at the same position, which are not
+// drawn, return the new index count
+size_t removeDegenerateTriangles(uint32_t *indices, size_t indexCount,
+    const std::vector<glm::vec3> &points)
+{
+  size_t count = 0;
+  for (size_t i = 0; i + 2 < indexCount; i += 3) {
+    const auto a = indices[i], b = indices[i + 1], c = indices[i + 2];
+    if (points[a] != points[b] && points[b] != points[c] &&
+        points[a] != points[c]) {
+      indices[count++] = a;
+      indices[count++] = b;
+      indices[count++] = c;
+    }
+  }
+  return count;
+}
+
+} // namespace
+
+size_t countVertexCacheMisses(const uint32_t *indices, size_t indexCount,
+    size_t vertexCount, size_t cacheSize)
+{
+  // A vertex is in the FIFO cache if less than cacheSize vertices entered it
+  // since it entered it
+  std::vector<size_t> entryTimes(vertexCount, 0);
+  auto time = cacheSize + 1;
+  size_t missCount = 0;
+  for (size_t i = 0; i < indexCount; ++i) {
+    const auto vertex = indices[i];
+    if (time - entryTimes[vertex] > cacheSize) {
+      entryTimes[vertex] = time++;
+      ++missCount;
+    }
+  }
+  return missCount;
+}
+
+void optimizeVertexCache(
+    uint32_t *indices, size_t indexCount, size_t vertexCount)
+{
+  const auto triangleCount = indexCount / 3;
+
+  // Triangles of each vertex not added yet, the first remainingCounts[v] of
+  // its range in vertexTriangles
+  std::vector<uint32_t> firstVertexTriangles(vertexCount + 1, 0);
+  for (size_t i = 0; i < 3 * triangleCount; ++i) {
+    ++firstVertexTriangles[indices[i] + 1];
+  }
+  for (size_t v = 0; v < vertexCount; ++v) {
+    firstVertexTriangles[v + 1] += firstVertexTriangles[v];
+  }
+  std::vector<uint32_t> remainingCounts(vertexCount, 0);
+  std::vector<uint32_t> vertexTriangles(3 * triangleCount);
+  for (size_t i = 0; i < 3 * triangleCount; ++i) {
+    const auto vertex = indices[i];
+    vertexTriangles[firstVertexTriangles[vertex] + remainingCounts[vertex]++] =
+        uint32_t(i / 3);
+  }
+
+  std::vector<int> cachePositions(vertexCount, -1);
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t v = 0; v < vertexCount; ++v) {
+    vertexScores[v] = computeVertexScore(-1, remainingCounts[v]);
+  }
+  std::vector<float> triangleScores(triangleCount, 0.f);
+  for (size_t i = 0; i < 3 * triangleCount; ++i) {
+    triangleScores[i / 3] += vertexScores[indices[i]];
+  }
+
+  std::vector<bool> isAdded(triangleCount, false);
+  std::vector<uint32_t> orderedIndices;
+  orderedIndices.reserve(3 * triangleCount);
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> nextCache;
+  size_t nextUnaddedTriangle = 0;
+  // Start from the best triangle overall
+  auto bestTriangle = size_t(
+      std::max_element(begin(triangleScores), end(triangleScores)) -
+      begin(triangleScores));
+  for (size_t addedCount = 0; addedCount < triangleCount; ++addedCount) {
+    if (bestTriangle == triangleCount) {
+      // No triangle uses the cache, start again from any other one. Linear
+      // overall since triangles before nextUnaddedTriangle are all added.
+      while (isAdded[nextUnaddedTriangle]) {
+        ++nextUnaddedTriangle;
+      }
+      bestTriangle = nextUnaddedTriangle;
+    }
+    const auto *triangle = indices + 3 * bestTriangle;
+    isAdded[bestTriangle] = true;
+    nextCache.clear();
+    for (int k = 0; k < 3; ++k) {
+      const auto vertex = triangle[k];
+      orderedIndices.emplace_back(vertex);
+      // Remove the triangle from the triangles of its vertices
+      const auto first = begin(vertexTriangles) + firstVertexTriangles[vertex];
+      const auto last = first + remainingCounts[vertex];
+      std::iter_swap(std::find(first, last, uint32_t(bestTriangle)), last - 1);
+      --remainingCounts[vertex];
+      if (std::find(begin(nextCache), end(nextCache), vertex) ==
+          end(nextCache)) {
+        nextCache.emplace_back(vertex);
+      }
+    }
+
+    // The vertices of the triangle enter the LRU cache, the least recently
+    // used ones are evicted
+    for (const auto vertex : cache) {
+      if (std::find(triangle, triangle + 3, vertex) == triangle + 3) {
+        nextCache.emplace_back(vertex);
+      }
+    }
+    for (size_t i = VERTEX_CACHE_SIZE; i < nextCache.size(); ++i) {
+      cachePositions[nextCache[i]] = -1;
+    }
+    for (size_t i = 0; i < std::min(VERTEX_CACHE_SIZE, nextCache.size());
+         ++i) {
+      cachePositions[nextCache[i]] = int(i);
+    }
+
+    // Only the scores of the vertices that moved, and of their triangles,
+    // change. The next triangle is the best one using the cache.
+    for (const auto vertex : nextCache) {
+      const auto score =
+          computeVertexScore(cachePositions[vertex], remainingCounts[vertex]);
+      const auto delta = score - vertexScores[vertex];
+      vertexScores[vertex] = score;
+      const auto first = firstVertexTriangles[vertex];
+      for (auto i = first; i < first + remainingCounts[vertex]; ++i) {
+        triangleScores[vertexTriangles[i]] += delta;
+      }
+    }
+    nextCache.resize(std::min(VERTEX_CACHE_SIZE, nextCache.size()));
+    std::swap(cache, nextCache);
+    bestTriangle = triangleCount;
+    auto bestScore = std::numeric_limits<float>::lowest();
+    for (const auto vertex : cache) {
+      const auto first = firstVertexTriangles[vertex];
+      for (auto i = first; i < first + remainingCounts[vertex]; ++i) {
+        const auto candidate = vertexTriangles[i];
+        if (triangleScores[candidate] > bestScore) {
+          bestScore = triangleScores[candidate];
+          bestTriangle = candidate;
+        }
+      }
+    }
+  }
+
+  std::copy(begin(orderedIndices), end(orderedIndices), indices);
+}
+
+size_t optimizeOverdraw(uint32_t *indices, size_t indexCount,
+    const float *positions, size_t vertexCount, float acmrThreshold)
+{
+  const auto triangleCount = indexCount / 3;
+  if (triangleCount == 0) {
+    return 0;
+  }
+  const auto clusters =
+      splitTriangleClusters(indices, triangleCount, vertexCount, acmrThreshold);
+  const auto clusterCount = clusters.size() - 1;
+
+  // Area weighted centroid and normal of each cluster
+  std::vector<glm::vec3> centroids(clusterCount);
+  std::vector<glm::vec3> normals(clusterCount);
+  for (size_t c = 0; c < clusterCount; ++c) {
+    glm::vec3 centroidSum(0.f);
+    glm::vec3 normalSum(0.f);
+    auto areaSum = 0.f;
+    for (auto t = clusters[c]; t < clusters[c + 1]; ++t) {
+      const auto a = glm::make_vec3(positions + 3 * size_t(indices[3 * t]));
+      const auto b = glm::make_vec3(positions + 3 * size_t(indices[3 * t + 1]));
+      const auto d = glm::make_vec3(positions + 3 * size_t(indices[3 * t + 2]));
+      const auto normal = glm::cross(b - a, d - a);
+      const auto area = glm::length(normal);
+      centroidSum += area * (a + b + d) / 3.f;
+      normalSum += normal;
+      areaSum += area;
+    }
+    centroids[c] =
+        areaSum > 0.f
+            ? centroidSum / areaSum
+            : glm::make_vec3(positions + 3 * size_t(indices[3 * clusters[c]]));
+    const auto normalLength = glm::length(normalSum);
+    normals[c] = normalLength > 0.f ? normalSum / normalLength : normalSum;
+  }
+
+  // Seen looking along each direction, clusters facing the viewer and in
+  // front of the others are the most likely to occlude them. Walls of
+  // interiors face the viewer only from behind what they contain.
+  std::vector<float> scores(clusterCount, 0.f);
+  std::vector<float> depths(clusterCount);
+  for (size_t i = 0; i < OVERDRAW_VIEW_DIRECTION_COUNT; ++i) {
+    const auto direction =
+        getFibonacciDirection(i, OVERDRAW_VIEW_DIRECTION_COUNT);
+    for (size_t c = 0; c < clusterCount; ++c) {
+      depths[c] = glm::dot(centroids[c], direction);
+    }
+    const auto range = std::minmax_element(begin(depths), end(depths));
+    const auto depthRange = *range.second - *range.first;
+    for (size_t c = 0; c < clusterCount; ++c) {
+      const auto facing = -glm::dot(normals[c], direction);
+      if (facing > 0.f) {
+        const auto frontness =
+            depthRange > 0.f ? (*range.second - depths[c]) / depthRange : 1.f;
+        scores[c] += facing * frontness;
+      }
+    }
+  }
+
+  std::vector<size_t> order(clusterCount);
+  std::iota(begin(order), end(order), size_t(0));
+  std::stable_sort(begin(order), end(order),
+      [&](size_t lhs, size_t rhs) { return scores[lhs] > scores[rhs]; });
+  std::vector<uint32_t> orderedIndices;
+  orderedIndices.reserve(3 * triangleCount);
+  for (const auto c : order) {
+    orderedIndices.insert(end(orderedIndices), indices + 3 * clusters[c],
+        indices + 3 * clusters[c + 1]);
+  }
+  std::copy(begin(orderedIndices), end(orderedIndices), indices);
+  return clusterCount;
+}
+
+TriangleOrderStatistics optimizeModelTriangleOrder(
+    tinygltf::Model &model, GltfBuffers &buffers, bool optimizeOverdraw)
+{
+  const auto accessors = findTriangleIndexAccessors(model, buffers);
+  std::vector<std::vector<uint32_t>> accessorIndices(accessors.size());
+  std::vector<TriangleOrderStatistics> accessorStatistics(accessors.size());
+  parallelFor(accessors.size(), [&](size_t i) {
+    const auto count = model.accessors[accessors[i].indices].count;
+    auto &indices = accessorIndices[i];
+    indices.resize(count);
+    readIndices(model, buffers, accessors[i].indices, 0, count, indices.data());
+    if (count == 0) {
+      return;
+    }
+    // Rebased so that per vertex arrays only cover the vertices used
+    const auto minIndex = *std::min_element(begin(indices), end(indices));
+    const auto maxIndex = *std::max_element(begin(indices), end(indices));
+    for (auto &index : indices) {
+      index -= minIndex;
+    }
+    const auto vertexCount = size_t(maxIndex - minIndex) + 1;
+    auto &statistics = accessorStatistics[i];
+    statistics.triangleCount = count / 3;
+    statistics.missCountBefore = countVertexCacheMisses(indices.data(),
+        indices.size(), vertexCount, MEASURED_VERTEX_CACHE_SIZE);
+    optimizeVertexCache(indices.data(), indices.size(), vertexCount);
+    const auto positions = accessors[i].positions;
+    if (optimizeOverdraw && positions >= 0 &&
+        maxIndex < model.accessors[positions].count) {
+      std::vector<float> vertexPositions(3 * vertexCount);
+      readVertexAttrib(model, buffers, positions, 3, minIndex, vertexCount,
+          vertexPositions.data(), 3);
+      statistics.clusterCount = ::optimizeOverdraw(indices.data(),
+          indices.size(), vertexPositions.data(), vertexCount,
+          OVERDRAW_ACMR_THRESHOLD);
+    }
+    statistics.missCountAfter = countVertexCacheMisses(indices.data(),
+        indices.size(), vertexCount, MEASURED_VERTEX_CACHE_SIZE);
+    for (auto &index : indices) {
+      index += minIndex;
+    }
+  });
+
+  // One bufferView per accessor, so that content hashes of unchanged
+  // primitives stay the same when others change
+  tinygltf::Buffer buffer;
+  const auto bufferIdx = int(model.buffers.size());
+  std::unordered_map<int, int> optimizedAccessors;
+  TriangleOrderStatistics statistics;
+  for (size_t i = 0; i < accessors.size(); ++i) {
+    const auto &indices = accessorIndices[i];
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferIdx;
+    bufferView.byteOffset = buffer.data.size();
+    bufferView.byteLength = indices.size() * sizeof(uint32_t);
+    bufferView.target = TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
+    buffer.data.resize(bufferView.byteOffset + bufferView.byteLength);
+    std::memcpy(buffer.data.data() + bufferView.byteOffset, indices.data(),
+        bufferView.byteLength);
+
+    tinygltf::Accessor accessor;
+    accessor.bufferView = int(model.bufferViews.size());
+    accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+    accessor.type = TINYGLTF_TYPE_SCALAR;
+    accessor.count = indices.size();
+    model.bufferViews.emplace_back(std::move(bufferView));
+    optimizedAccessors[accessors[i].indices] = int(model.accessors.size());
+    model.accessors.emplace_back(std::move(accessor));
+
+    statistics.triangleCount += accessorStatistics[i].triangleCount;
+    statistics.missCountBefore += accessorStatistics[i].missCountBefore;
+    statistics.missCountAfter += accessorStatistics[i].missCountAfter;
+    statistics.clusterCount += accessorStatistics[i].clusterCount;
+  }
+  if (accessors.empty()) {
+    return statistics;
+  }
+  model.buffers.emplace_back(std::move(buffer));
+  // Moving buffers keeps their data where it is, other views stay valid
+  buffers.bytes.emplace_back(BufferBytes{
+      model.buffers.back().data.data(), model.buffers.back().data.size()});
+
+  for (auto &mesh : model.meshes) {
+    for (auto &primitive : mesh.primitives) {
+      const auto it = optimizedAccessors.find(primitive.indices);
+      if (primitive.mode == TINYGLTF_MODE_TRIANGLES &&
+          it != end(optimizedAccessors)) {
+        primitive.indices = it->second;
+      }
+    }
+  }
+  return statistics;
+}
+
+size_t countVertexFetchBytes(const uint32_t *indices, size_t indexCount,
+    size_t vertexCount, size_t vertexByteSize)
+{
+  const auto cacheSize = MEASURED_VERTEX_CACHE_SIZE;
+  std::vector<size_t> entryTimes(vertexCount, 0);
+  auto time = cacheSize + 1;
+  std::vector<size_t> cacheLines(
+      VERTEX_FETCH_CACHE_LINE_COUNT, std::numeric_limits<size_t>::max());
+  size_t byteCount = 0;
+  for (size_t i = 0; i < indexCount; ++i) {
+    const auto vertex = indices[i];
+    // Only vertices missing the post-transform cache are fetched
+    if (time - entryTimes[vertex] <= cacheSize) {
+      continue;
+    }
+    entryTimes[vertex] = time++;
+    const auto firstByte = vertex * vertexByteSize;
+    const auto lastByte = firstByte + vertexByteSize - 1;
+    for (auto line = firstByte / VERTEX_FETCH_CACHE_LINE_SIZE;
+         line <= lastByte / VERTEX_FETCH_CACHE_LINE_SIZE; ++line) {
+      auto &cacheLine = cacheLines[line % VERTEX_FETCH_CACHE_LINE_COUNT];
+      if (cacheLine != line) {
+        cacheLine = line;
+        byteCount += VERTEX_FETCH_CACHE_LINE_SIZE;
+      }
+    }
+  }
+  return byteCount;
+}
+
+size_t optimizeVertexFetch(uint32_t *indices, size_t indexCount,
+    size_t vertexCount, uint32_t *remap)
+{
+  std::fill(remap, remap + vertexCount, UNUSED_VERTEX);
+  uint32_t usedVertexCount = 0;
+  for (size_t i = 0; i < indexCount; ++i) {
+    auto &index = indices[i];
+    if (remap[index] == UNUSED_VERTEX) {
+      remap[index] = usedVertexCount++;
+    }
+    index = remap[index];
+  }
+  return usedVertexCount;
+}
+
+VertexFetchStatistics optimizeModelVertexFetch(
+    tinygltf::Model &model, GltfBuffers &buffers)
+{
+  std::vector<VertexSet> sets;
+  std::map<std::vector<int>, size_t> setIndices;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      if (!isIndicesReadable(model, buffers, primitive.indices)) {
+        continue;
+      }
+      auto vertexAccessors = getVertexAccessors(primitive);
+      const auto it = setIndices.emplace(vertexAccessors, sets.size()).first;
+      if (it->second == sets.size()) {
+        sets.emplace_back();
+        sets.back().vertexAccessors = std::move(vertexAccessors);
+      }
+      auto &indexAccessors = sets[it->second].indexAccessors;
+      if (std::find(begin(indexAccessors), end(indexAccessors),
+              primitive.indices) == end(indexAccessors)) {
+        indexAccessors.emplace_back(primitive.indices);
+      }
+    }
+  }
+  std::vector<RenumberedVertexSet> renumberedSets(sets.size());
+  parallelFor(sets.size(), [&](size_t i) {
+    renumberedSets[i] = renumberVertexSet(model, buffers, sets[i]);
+  });
+
+  // Same layout as optimizeModelTriangleOrder(): one bufferView per accessor
+  tinygltf::Buffer buffer;
+  const auto bufferIdx = int(model.buffers.size());
+  const auto addBufferView = [&](const void *data, size_t byteLength,
+                                 size_t byteStride, int target) {
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferIdx;
+    bufferView.byteOffset = buffer.data.size();
+    bufferView.byteLength = byteLength;
+    bufferView.byteStride = byteStride;
+    bufferView.target = target;
+    buffer.data.resize(bufferView.byteOffset + byteLength);
+    std::memcpy(buffer.data.data() + bufferView.byteOffset, data, byteLength);
+    model.bufferViews.emplace_back(std::move(bufferView));
+    return int(model.bufferViews.size() - 1);
+  };
+  // New accessor of each accessor read by each vertex set
+  std::vector<std::unordered_map<int, int>> renumberedAccessors(sets.size());
+  std::vector<bool> isRenumbered(model.accessors.size(), false);
+  VertexFetchStatistics statistics;
+  for (size_t i = 0; i < sets.size(); ++i) {
+    const auto &set = sets[i];
+    const auto &renumbered = renumberedSets[i];
+    if (!renumbered.isRenumbered) {
+      continue;
+    }
+    for (size_t j = 0; j < set.vertexAccessors.size(); ++j) {
+      const auto accessorIdx = set.vertexAccessors[j];
+      if (isRenumbered[accessorIdx]) {
+        ++statistics.duplicatedAccessorCount;
+      }
+      isRenumbered[accessorIdx] = true;
+      // Bounds of the accessor are kept, they still bound the vertices used
+      auto accessor = model.accessors[accessorIdx];
+      accessor.count = renumbered.vertexCount;
+      accessor.byteOffset = 0;
+      const auto &data = renumbered.vertexData[j];
+      if (accessor.bufferView >= 0) {
+        accessor.bufferView = addBufferView(data.data(), data.size(),
+            renumbered.byteStrides[j], TINYGLTF_TARGET_ARRAY_BUFFER);
+      }
+      renumberedAccessors[i][accessorIdx] = int(model.accessors.size());
+      model.accessors.emplace_back(std::move(accessor));
+    }
+    for (size_t j = 0; j < set.indexAccessors.size(); ++j) {
+      const auto first = renumbered.firstIndices[j];
+      const auto count = renumbered.firstIndices[j + 1] - first;
+      tinygltf::Accessor accessor;
+      accessor.bufferView = addBufferView(renumbered.indices.data() + first,
+          count * sizeof(uint32_t), 0, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+      accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+      accessor.type = TINYGLTF_TYPE_SCALAR;
+      accessor.count = count;
+      renumberedAccessors[i][set.indexAccessors[j]] =
+          int(model.accessors.size());
+      model.accessors.emplace_back(std::move(accessor));
+    }
+
+    const auto &setStatistics = renumbered.statistics;
+    statistics.vertexCount += setStatistics.vertexCount;
+    statistics.usedVertexCount += setStatistics.usedVertexCount;
+    statistics.usedByteCount += setStatistics.usedByteCount;
+    statistics.fetchedByteCountBefore += setStatistics.fetchedByteCountBefore;
+    statistics.fetchedByteCountAfter += setStatistics.fetchedByteCountAfter;
+  }
+  if (buffer.data.empty()) {
+    return statistics;
+  }
+  model.buffers.emplace_back(std::move(buffer));
+  buffers.bytes.emplace_back(BufferBytes{
+      model.buffers.back().data.data(), model.buffers.back().data.size()});
+
+  for (auto &mesh : model.meshes) {
+    for (auto &primitive : mesh.primitives) {
+      if (!isIndicesReadable(model, buffers, primitive.indices)) {
+        continue;
+      }
+      const auto it = setIndices.find(getVertexAccessors(primitive));
+      if (it == end(setIndices) || !renumberedSets[it->second].isRenumbered) {
+        continue;
+      }
+      const auto &accessors = renumberedAccessors[it->second];
+      primitive.indices = accessors.at(primitive.indices);
+      for (auto &attribute : primitive.attributes) {
+        if (isVertexAttribute(attribute.first)) {
+          attribute.second = accessors.at(attribute.second);
+        }
+      }
+      for (auto &target : primitive.targets) {
+        for (auto &attribute : target) {
+          attribute.second = accessors.at(attribute.second);
+        }
+      }
+    }
+  }
+  return statistics;
+}
+
+std::vector<Meshlet> buildMeshlets(const uint32_t *indices, size_t indexCount,
+    const float *positions, size_t vertexCount)
+{
+  std::vector<Meshlet> meshlets;
+  // Vertices of the meshlet being built are those whose last meshlet is it
+  std::vector<size_t> lastMeshlets(
+      vertexCount, std::numeric_limits<size_t>::max());
+  std::vector<uint32_t> meshletVertices;
+  Meshlet meshlet;
+  for (size_t t = 0; t < indexCount / 3; ++t) {
+    const auto *triangle = indices + 3 * t;
+    size_t newVertexCount = 0;
+    for (size_t k = 0; k < 3; ++k) {
+      if (lastMeshlets[triangle[k]] != meshlets.size() &&
+          std::find(triangle, triangle + k, triangle[k]) == triangle + k) {
+        ++newVertexCount;
+      }
+    }
+    if (meshletVertices.size() + newVertexCount > MESHLET_MAX_VERTEX_COUNT ||
+        meshlet.triangleCount == MESHLET_MAX_TRIANGLE_COUNT) {
+      computeMeshletBounds(meshlet, indices, positions, meshletVertices);
+      meshlets.emplace_back(meshlet);
+      meshletVertices.clear();
+      meshlet = Meshlet{};
+      meshlet.firstIndex = uint32_t(3 * t);
+    }
+    for (size_t k = 0; k < 3; ++k) {
+      if (lastMeshlets[triangle[k]] != meshlets.size()) {
+        lastMeshlets[triangle[k]] = meshlets.size();
+        meshletVertices.emplace_back(triangle[k]);
+      }
+    }
+    ++meshlet.triangleCount;
+  }
+  if (meshlet.triangleCount > 0) {
+    computeMeshletBounds(meshlet, indices, positions, meshletVertices);
+    meshlets.emplace_back(meshlet);
+  }
+  return meshlets;
+}
+
+MeshletStatistics buildModelMeshlets(
+    tinygltf::Model &model, GltfBuffers &buffers)
+{
+  const auto accessors = findTriangleIndexAccessors(model, buffers);
+  // Triangles of double sided materials are visible from behind, their
+  // meshlets are never culled for facing away
+  std::unordered_map<int, bool> isDoubleSided;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      if (primitive.material >= 0 &&
+          size_t(primitive.material) < model.materials.size() &&
+          model.materials[primitive.material].doubleSided) {
+        isDoubleSided[primitive.indices] = true;
+      }
+    }
+  }
+  std::vector<std::vector<Meshlet>> accessorMeshlets(accessors.size());
+  std::vector<MeshletStatistics> accessorStatistics(accessors.size());
+  parallelFor(accessors.size(), [&](size_t i) {
+    const auto count = model.accessors[accessors[i].indices].count;
+    const auto positions = accessors[i].positions;
+    if (count < 3 || positions < 0) {
+      return;
+    }
+    std::vector<uint32_t> indices(count);
+    readIndices(model, buffers, accessors[i].indices, 0, count, indices.data());
+    // Rebased so that only the positions used are read, meshlets keep the
+    // indices of the accessor
+    const auto minIndex = *std::min_element(begin(indices), end(indices));
+    const auto maxIndex = *std::max_element(begin(indices), end(indices));
+    if (maxIndex >= model.accessors[positions].count) {
+      return;
+    }
+    for (auto &index : indices) {
+      index -= minIndex;
+    }
+    const auto vertexCount = size_t(maxIndex - minIndex) + 1;
+    std::vector<float> vertexPositions(3 * vertexCount);
+    readVertexAttrib(model, buffers, positions, 3, minIndex, vertexCount,
+        vertexPositions.data(), 3);
+    auto &meshlets = accessorMeshlets[i];
+    meshlets = buildMeshlets(
+        indices.data(), indices.size(), vertexPositions.data(), vertexCount);
+    if (isDoubleSided.count(accessors[i].indices)) {
+      for (auto &meshlet : meshlets) {
+        meshlet.coneCutoff = 1.f;
+      }
+    }
+
+    auto &statistics = accessorStatistics[i];
+    statistics.triangleCount = count / 3;
+    statistics.meshletCount = meshlets.size();
+    std::vector<size_t> lastMeshlets(
+        vertexCount, std::numeric_limits<size_t>::max());
+    for (size_t m = 0; m < meshlets.size(); ++m) {
+      const auto first = meshlets[m].firstIndex;
+      for (auto j = first; j < first + 3 * meshlets[m].triangleCount; ++j) {
+        if (lastMeshlets[indices[j]] != m) {
+          lastMeshlets[indices[j]] = m;
+          ++statistics.meshletVertexCount;
+        }
+      }
+    }
+  });
+
+  // The meshlets of each index accessor are in their own bufferView, read by
+  // an accessor per group of members
+  tinygltf::Buffer buffer;
+  const auto bufferIdx = int(model.buffers.size());
+  // First meshlet accessor of each index accessor, with positions
+  std::unordered_map<int, std::pair<int, int>> meshletAccessors;
+  MeshletStatistics statistics;
+  for (size_t i = 0; i < accessors.size(); ++i) {
+    const auto &meshlets = accessorMeshlets[i];
+    if (meshlets.empty()) {
+      continue;
+    }
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferIdx;
+    bufferView.byteOffset = buffer.data.size();
+    bufferView.byteLength = meshlets.size() * sizeof(Meshlet);
+    bufferView.byteStride = sizeof(Meshlet);
+    buffer.data.resize(bufferView.byteOffset + bufferView.byteLength);
+    std::memcpy(buffer.data.data() + bufferView.byteOffset, meshlets.data(),
+        bufferView.byteLength);
+    const auto bufferViewIdx = int(model.bufferViews.size());
+    model.bufferViews.emplace_back(std::move(bufferView));
+
+    meshletAccessors[accessors[i].indices] = {
+        int(model.accessors.size()), accessors[i].positions};
+    const struct
+    {
+      int componentType;
+      int type;
+      size_t byteOffset;
+    } members[] = {{TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT, TINYGLTF_TYPE_VEC2,
+                       offsetof(Meshlet, firstIndex)},
+        {TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC4,
+            offsetof(Meshlet, center)},
+        {TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC4,
+            offsetof(Meshlet, coneAxis)}};
+    for (const auto &member : members) {
+      tinygltf::Accessor accessor;
+      accessor.bufferView = bufferViewIdx;
+      accessor.byteOffset = member.byteOffset;
+      accessor.componentType = member.componentType;
+      accessor.type = member.type;
+      accessor.count = meshlets.size();
+      model.accessors.emplace_back(std::move(accessor));
+    }
+
+    statistics.triangleCount += accessorStatistics[i].triangleCount;
+    statistics.meshletCount += accessorStatistics[i].meshletCount;
+    statistics.meshletVertexCount += accessorStatistics[i].meshletVertexCount;
+  }
+  if (buffer.data.empty()) {
+    return statistics;
+  }
+  model.buffers.emplace_back(std::move(buffer));
+  buffers.bytes.emplace_back(BufferBytes{
+      model.buffers.back().data.data(), model.buffers.back().data.size()});
+
+  // Meshlet bounds are those of the positions they were built with
+  for (auto &mesh : model.meshes) {
+    for (auto &primitive : mesh.primitives) {
+      const auto it = meshletAccessors.find(primitive.indices);
+      const auto positionIt = primitive.attributes.find("POSITION");
+      if (primitive.mode != TINYGLTF_MODE_TRIANGLES ||
+          it == end(meshletAccessors) ||
+          positionIt == end(primitive.attributes) ||
+          positionIt->second != it->second.second) {
+        continue;
+      }
+      primitive.attributes[MESHLET_RANGES_ATTRIBUTE] = it->second.first;
+      primitive.attributes[MESHLET_SPHERES_ATTRIBUTE] = it->second.first + 1;
+      primitive.attributes[MESHLET_CONES_ATTRIBUTE] = it->second.first + 2;
+    }
+  }
+  return statistics;
+}
+
+size_t simplify(uint32_t *indices, size_t indexCount, const float *positions,
+    size_t vertexCount, size_t targetIndexCount, float maxError, float &error)
+{
+  error = 0.f;
+  if (indexCount <= targetIndexCount) {
+    return indexCount;
+  }
+  // Errors are computed with the mesh in a unit cube
+  auto boundsMin = glm::vec3(std::numeric_limits<float>::max());
+  auto boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+  for (size_t i = 0; i < indexCount; ++i) {
+    const auto position = glm::make_vec3(positions + 3 * size_t(indices[i]));
+    boundsMin = glm::min(boundsMin, position);
+    boundsMax = glm::max(boundsMax, position);
+  }
+  const auto extent = std::max(boundsMax.x - boundsMin.x,
+      std::max(boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z));
+  if (extent <= 0.f) {
+    return indexCount;
+  }
+  std::vector<glm::vec3> points(vertexCount);
+  for (size_t v = 0; v < vertexCount; ++v) {
+    points[v] = (glm::make_vec3(positions + 3 * v) - boundsMin) / extent;
+  }
+  indexCount = removeDegenerateTriangles(indices, indexCount, points);
+  auto topology = classifyVertices(indices, indexCount, points);
+  const auto &kinds = topology.kinds;
+  auto &loops = topology.loops;
+  auto &loopbacks = topology.loopbacks;
+
+  // Planes of the triangles around each vertex, and of its borders and seams
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i < indexCount; i += 3) {
+    const glm::dvec3 p0(points[indices[i]]);
+    const auto faceNormal = glm::cross(
+        glm::dvec3(points[indices[i + 1]]) - p0,
+        glm::dvec3(points[indices[i + 2]]) - p0);
+    const auto doubleArea = glm::length(faceNormal);
+    if (doubleArea == 0.) {
+      continue;
+    }
+    const auto normal = faceNormal / doubleArea;
+    for (size_t k = 0; k < 3; ++k) {
+      addPlane(quadrics[indices[i + k]], normal, -glm::dot(normal, p0),
+          0.5 * doubleArea);
+    }
+    for (size_t k = 0; k < 3; ++k) {
+      const auto a = indices[i + k];
+      const auto b = indices[i + (k + 1) % 3];
+      if (loops[a] != b) {
+        continue;
+      }
+      const glm::dvec3 pa(points[a]);
+      const auto edge = glm::dvec3(points[b]) - pa;
+      const auto edgeNormal = glm::cross(edge, normal);
+      const auto length = glm::length(edgeNormal);
+      if (length > 0.) {
+        const auto weight = BORDER_QUADRIC_WEIGHT * glm::dot(edge, edge);
+        const auto planeNormal = edgeNormal / length;
+        addPlane(quadrics[a], planeNormal, -glm::dot(planeNormal, pa), weight);
+        addPlane(quadrics[b], planeNormal, -glm::dot(planeNormal, pa), weight);
+      }
+    }
+  }
+
+  const auto canCollapse = [&](uint32_t vertex, uint32_t target) {
+    return kinds[vertex] == VERTEX_MANIFOLD ||
+           ((kinds[vertex] == VERTEX_BORDER || kinds[vertex] == VERTEX_SEAM) &&
+               (loops[vertex] == target || loopbacks[vertex] == target));
+  };
+  // Vertex the wedge of a seam vertex collapses onto, along the other side of
+  // the seam, NO_VERTEX if the seam does not go on there
+  const auto getWedgeTarget = [&](uint32_t vertex, uint32_t target) {
+    const auto wedge = topology.wedges[vertex];
+    const auto wedgeTarget =
+        loops[vertex] == target ? loopbacks[wedge] : loops[wedge];
+    return wedgeTarget != NO_VERTEX && wedgeTarget != target &&
+                   topology.positionVertices[wedgeTarget] ==
+                       topology.positionVertices[target]
+               ? wedgeTarget
+               : NO_VERTEX;
+  };
+  const auto getCollapseCost = [&](uint32_t vertex, uint32_t target) {
+    if (kinds[vertex] != VERTEX_SEAM) {
+      return evaluateQuadric(quadrics[vertex], glm::dvec3(points[target]));
+    }
+    auto quadric = quadrics[vertex];
+    addQuadric(quadric, quadrics[topology.wedges[vertex]]);
+    return evaluateQuadric(quadric, glm::dvec3(points[target]));
+  };
+
+  struct Collapse
+  {
+    uint32_t vertex;
+    uint32_t target;
+    double cost;
+  };
+  const auto maxCost = double(maxError) * double(maxError);
+  auto maxCollapseCost = 0.;
+  std::vector<uint32_t> firstVertexTriangles(vertexCount + 1);
+  std::vector<uint32_t> vertexTriangles;
+  std::vector<uint32_t> collapseTargets(vertexCount);
+  std::vector<double> collapseCosts(vertexCount);
+  std::vector<Collapse> collapses;
+  std::vector<bool> isTouched(vertexCount);
+  std::vector<uint32_t> remap(vertexCount);
+  std::iota(begin(remap), end(remap), 0u);
+
+  // Triangles moving with the vertex must not flip
+  const auto isFlipping = [&](uint32_t vertex, uint32_t target) {
+    for (auto t = firstVertexTriangles[vertex];
+         t < firstVertexTriangles[vertex + 1]; ++t) {
+      const auto *triangle = indices + 3 * vertexTriangles[t];
+      if (std::find(triangle, triangle + 3, target) != triangle + 3) {
+        continue;
+      }
+      glm::vec3 corners[3];
+      glm::vec3 movedCorners[3];
+      for (size_t k = 0; k < 3; ++k) {
+        corners[k] = points[triangle[k]];
+        movedCorners[k] = triangle[k] == vertex ? points[target] : corners[k];
+      }
+      const auto normal =
+          glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+      const auto movedNormal = glm::cross(movedCorners[1] - movedCorners[0],
+          movedCorners[2] - movedCorners[0]);
+      if (glm::dot(normal, movedNormal) <= 0.f) {
+        return true;
+      }
+    }
+    return false;
+  };
+  const auto collapseVertex = [&](uint32_t vertex, uint32_t target) {
+    remap[vertex] = target;
+    addQuadric(quadrics[target], quadrics[vertex]);
+    if (kinds[vertex] == VERTEX_BORDER || kinds[vertex] == VERTEX_SEAM) {
+      if (loops[vertex] == target) {
+        loops[loopbacks[vertex]] = target;
+        loopbacks[target] = loopbacks[vertex];
+      } else {
+        loopbacks[loops[vertex]] = target;
+        loops[target] = loops[vertex];
+      }
+    }
+    for (auto t = firstVertexTriangles[vertex];
+         t < firstVertexTriangles[vertex + 1]; ++t) {
+      for (size_t k = 0; k < 3; ++k) {
+        isTouched[indices[3 * vertexTriangles[t] + k]] = true;
+      }
+    }
+  };
+
+  while (indexCount > targetIndexCount) {
+    // Triangles around each vertex
+    std::fill(begin(firstVertexTriangles), end(firstVertexTriangles), 0u);
+    for (size_t i = 0; i < indexCount; ++i) {
+      ++firstVertexTriangles[indices[i] + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+      firstVertexTriangles[v + 1] += firstVertexTriangles[v];
+    }
+    vertexTriangles.resize(indexCount);
+    for (size_t i = 0; i < indexCount; ++i) {
+      vertexTriangles[firstVertexTriangles[indices[i]]++] = uint32_t(i / 3);
+    }
+    for (size_t v = vertexCount; v > 0; --v) {
+      firstVertexTriangles[v] = firstVertexTriangles[v - 1];
+    }
+    firstVertexTriangles[0] = 0;
+
+    // Cheapest collapse of each vertex onto one of its neighbours
+    std::fill(begin(collapseTargets), end(collapseTargets), NO_VERTEX);
+    for (size_t i = 0; i < indexCount; ++i) {
+      const auto a = indices[i];
+      const auto b = indices[i % 3 == 2 ? i - 2 : i + 1];
+      for (const auto &edge : {std::make_pair(a, b), std::make_pair(b, a)}) {
+        if (!canCollapse(edge.first, edge.second) ||
+            (kinds[edge.first] == VERTEX_SEAM &&
+                getWedgeTarget(edge.first, edge.second) == NO_VERTEX)) {
+          continue;
+        }
+        const auto cost = getCollapseCost(edge.first, edge.second);
+        if (collapseTargets[edge.first] == NO_VERTEX ||
+            cost < collapseCosts[edge.first]) {
+          collapseTargets[edge.first] = edge.second;
+          collapseCosts[edge.first] = cost;
+        }
+      }
+    }
+    collapses.clear();
+    for (size_t v = 0; v < vertexCount; ++v) {
+      // One collapse per seam, made by its first wedge
+      if (collapseTargets[v] != NO_VERTEX && collapseCosts[v] <= maxCost &&
+          (kinds[v] != VERTEX_SEAM || topology.wedges[v] > v)) {
+        collapses.push_back(
+            {uint32_t(v), collapseTargets[v], collapseCosts[v]});
+      }
+    }
+    std::sort(begin(collapses), end(collapses),
+        [](const Collapse &lhs, const Collapse &rhs) {
+          return lhs.cost < rhs.cost;
+        });
+
+    // Cheapest collapses first, each removing about two triangles, until the
+    // target is reached. Vertices around a collapse are left for the next
+    // pass, so that the triangles around a collapse are those of the pass.
+    std::fill(begin(isTouched), end(isTouched), false);
+    const auto triangleGoal = (indexCount - targetIndexCount) / 3;
+    size_t removedTriangleCount = 0;
+    size_t collapseCount = 0;
+    for (const auto &collapse : collapses) {
+      if (removedTriangleCount >= triangleGoal) {
+        break;
+      }
+      const auto vertex = collapse.vertex;
+      const auto target = collapse.target;
+      if (isTouched[vertex] || isTouched[target] ||
+          isFlipping(vertex, target)) {
+        continue;
+      }
+      if (kinds[vertex] == VERTEX_SEAM) {
+        const auto wedge = topology.wedges[vertex];
+        const auto wedgeTarget = getWedgeTarget(vertex, target);
+        if (isTouched[wedge] || isTouched[wedgeTarget] ||
+            isFlipping(wedge, wedgeTarget)) {
+          continue;
+        }
+        collapseVertex(wedge, wedgeTarget);
+      }
+      collapseVertex(vertex, target);
+      removedTriangleCount += kinds[vertex] == VERTEX_BORDER ? 1 : 2;
+      maxCollapseCost = std::max(maxCollapseCost, collapse.cost);
+      ++collapseCount;
+    }
+    if (collapseCount == 0) {
+      break;
+    }
+    for (size_t i = 0; i < indexCount; ++i) {
+      indices[i] = remap[indices[i]];
+    }
+    indexCount = removeDegenerateTriangles(indices, indexCount, points);
+  }
+  error = float(std::sqrt(maxCollapseCost)) * extent;
+  return indexCount;
+}
+
+LodStatistics buildModelLods(tinygltf::Model &model, GltfBuffers &buffers)
+{
+  const auto accessors = findTriangleIndexAccessors(model, buffers);
+  // Indices of each level of each accessor, and their errors
+  std::vector<std::vector<std::vector<uint32_t>>> accessorLods(
+      accessors.size());
+  std::vector<std::vector<float>> accessorErrors(accessors.size());
+  parallelFor(accessors.size(), [&](size_t i) {
+    const auto count = model.accessors[accessors[i].indices].count;
+    const auto positions = accessors[i].positions;
+    if (count < 3 || positions < 0) {
+      return;
+    }
+    std::vector<uint32_t> indices(count);
+    readIndices(model, buffers, accessors[i].indices, 0, count, indices.data());
+    const auto minIndex = *std::min_element(begin(indices), end(indices));
+    const auto maxIndex = *std::max_element(begin(indices), end(indices));
+    if (maxIndex >= model.accessors[positions].count) {
+      return;
+    }
+    for (auto &index : indices) {
+      index -= minIndex;
+    }
+    const auto vertexCount = size_t(maxIndex - minIndex) + 1;
+    std::vector<float> vertexPositions(3 * vertexCount);
+    readVertexAttrib(model, buffers, positions, 3, minIndex, vertexCount,
+        vertexPositions.data(), 3);
+
+    // Each level simplifies the previous one, errors add up
+    auto error = 0.f;
+    for (size_t level = 0; level < MAX_LOD_COUNT; ++level) {
+      const auto targetTriangleCount =
+          size_t(LOD_TRIANGLE_RATIO * float(indices.size() / 3));
+      if (targetTriangleCount < LOD_MIN_TRIANGLE_COUNT) {
+        break;
+      }
+      auto lodIndices = indices;
+      auto lodError = 0.f;
+      lodIndices.resize(simplify(lodIndices.data(), lodIndices.size(),
+          vertexPositions.data(), vertexCount, 3 * targetTriangleCount,
+          LOD_MAX_RELATIVE_ERROR, lodError));
+      // Levels that barely simplify the previous one are not worth their
+      // memory
+      if (lodIndices.empty() || 4 * lodIndices.size() > 3 * indices.size()) {
+        break;
+      }
+      optimizeVertexCache(lodIndices.data(), lodIndices.size(), vertexCount);
+      indices = lodIndices;
+      error += lodError;
+      for (auto &index : lodIndices) {
+        index += minIndex;
+      }
+      accessorLods[i].emplace_back(std::move(lodIndices));
+      accessorErrors[i].emplace_back(error);
+    }
+  });
+
+  // Same layout as optimizeModelTriangleOrder() for the indices of each
+  // level, followed by the errors of the levels
+  tinygltf::Buffer buffer;
+  const auto bufferIdx = int(model.buffers.size());
+  const auto addAccessor = [&](const void *data, size_t count,
+                               int componentType, int target) {
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferIdx;
+    bufferView.byteOffset = buffer.data.size();
+    bufferView.byteLength = count * 4;
+    bufferView.target = target;
+    buffer.data.resize(bufferView.byteOffset + bufferView.byteLength);
+    std::memcpy(buffer.data.data() + bufferView.byteOffset, data,
+        bufferView.byteLength);
+    tinygltf::Accessor accessor;
+    accessor.bufferView = int(model.bufferViews.size());
+    accessor.componentType = componentType;
+    accessor.type = TINYGLTF_TYPE_SCALAR;
+    accessor.count = count;
+    model.bufferViews.emplace_back(std::move(bufferView));
+    model.accessors.emplace_back(std::move(accessor));
+    return int(model.accessors.size() - 1);
+  };
+  // Accessors of the levels of each index accessor, and of their errors
+  std::unordered_map<int, std::vector<int>> lodAccessors;
+  LodStatistics statistics;
+  for (size_t i = 0; i < accessors.size(); ++i) {
+    const auto &lods = accessorLods[i];
+    if (lods.empty()) {
+      continue;
+    }
+    auto &levelAccessors = lodAccessors[accessors[i].indices];
+    for (const auto &lodIndices : lods) {
+      levelAccessors.emplace_back(addAccessor(lodIndices.data(),
+          lodIndices.size(), TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT,
+          TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER));
+    }
+    levelAccessors.emplace_back(addAccessor(accessorErrors[i].data(),
+        accessorErrors[i].size(), TINYGLTF_COMPONENT_TYPE_FLOAT, 0));
+
+    ++statistics.primitiveCount;
+    statistics.levelTriangleCounts[0] +=
+        model.accessors[accessors[i].indices].count / 3;
+    for (size_t level = 0; level < lods.size(); ++level) {
+      statistics.levelTriangleCounts[level + 1] += lods[level].size() / 3;
+    }
+  }
+  if (buffer.data.empty()) {
+    return statistics;
+  }
+  model.buffers.emplace_back(std::move(buffer));
+  buffers.bytes.emplace_back(BufferBytes{
+      model.buffers.back().data.data(), model.buffers.back().data.size()});
+
+  // Levels are simplified from the positions they were built with
+  std::unordered_map<int, int> lodPositions;
+  for (size_t i = 0; i < accessors.size(); ++i) {
+    lodPositions[accessors[i].indices] = accessors[i].positions;
+  }
+  for (auto &mesh : model.meshes) {
+    for (auto &primitive : mesh.primitives) {
+      const auto it = lodAccessors.find(primitive.indices);
+      const auto positionIt = primitive.attributes.find("POSITION");
+      if (primitive.mode != TINYGLTF_MODE_TRIANGLES ||
+          it == end(lodAccessors) ||
+          positionIt == end(primitive.attributes) ||
+          positionIt->second != lodPositions[primitive.indices]) {
+        continue;
+      }
+      const auto &levelAccessors = it->second;
+      for (size_t level = 0; level + 1 < levelAccessors.size(); ++level) {
+        primitive.attributes[LOD_INDICES_ATTRIBUTE +
+                             std::to_string(level + 1)] =
+            levelAccessors[level];
+      }
+      primitive.attributes[LOD_ERRORS_ATTRIBUTE] = levelAccessors.back();
+    }
+  }
+  return statistics;
+}
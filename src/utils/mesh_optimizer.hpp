@@ -0,0 +1,168 @@
+#pragma once
+
+#include "geometry_arena.hpp"
+#include "gltf_loader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <tiny_gltf.h>
+#include <vector>
+
+// Import stages reordering the geometry of a model for the GPU, run once the
+// model is loaded and before it is stored in the scene cache
+
+// Vertices of the post-transform cache the optimization is tuned for, and of
+// the FIFO cache simulated to measure it
+const size_t VERTEX_CACHE_SIZE = 32;
+const size_t MEASURED_VERTEX_CACHE_SIZE = 16;
+
+// Vertices transformed when drawing the triangles with a FIFO post-transform
+// cache of cacheSize vertices. Divided by the number of triangles, it gives
+// the average cache miss ratio (ACMR), 0.5 at best for large grids, 3 at worst.
+// Indices must be less than vertexCount.
+size_t countVertexCacheMisses(const uint32_t *indices, size_t indexCount,
+    size_t vertexCount, size_t cacheSize);
+
+// Reorder triangles so that consecutive triangles share vertices in an LRU
+// cache of VERTEX_CACHE_SIZE vertices, with Tom Forsyth's linear-speed
+// algorithm. Indices must be less than vertexCount.
+void optimizeVertexCache(uint32_t *indices, size_t indexCount,
+    size_t vertexCount);
+
+// Triangles are split into clusters whose ACMR, drawn from an empty cache, is
+// at most this ratio of the ACMR of their whole mesh
+const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+// Reorder clusters of triangles ordered by optimizeVertexCache() so that those
+// in front of the others, seen from a set of view directions around the mesh,
+// are drawn first and occlude them in the depth test, as described by Sander
+// et al. in "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw". positions holds 3 floats per vertex. Returns the number of
+// clusters.
+size_t optimizeOverdraw(uint32_t *indices, size_t indexCount,
+    const float *positions, size_t vertexCount, float acmrThreshold);
+
+struct TriangleOrderStatistics
+{
+  size_t triangleCount = 0;
+  // Measured with MEASURED_VERTEX_CACHE_SIZE vertices
+  size_t missCountBefore = 0;
+  size_t missCountAfter = 0;
+  // Clusters reordered by optimizeOverdraw()
+  size_t clusterCount = 0;
+};
+
+// Reorder the triangles of every indexed TRIANGLES primitive for the vertex
+// cache then, if optimizeOverdraw is true, for overdraw, in parallel.
+// Reordered indices are stored in a new buffer, appended to the model and to
+// buffers, and primitives read them through new accessors.
+TriangleOrderStatistics optimizeModelTriangleOrder(
+    tinygltf::Model &model, GltfBuffers &buffers, bool optimizeOverdraw);
+
+// Cache of vertex memory simulated to measure vertex fetches: direct mapped,
+// of VERTEX_FETCH_CACHE_LINE_COUNT lines of VERTEX_FETCH_CACHE_LINE_SIZE bytes
+const size_t VERTEX_FETCH_CACHE_LINE_SIZE = 64;
+const size_t VERTEX_FETCH_CACHE_LINE_COUNT = 256;
+
+// Bytes read from memory to draw the triangles with vertices of
+// vertexByteSize bytes stored one after the other, behind a FIFO
+// post-transform cache of MEASURED_VERTEX_CACHE_SIZE vertices. Divided by the
+// bytes of the vertices used, it gives the overfetch ratio, 1 at best.
+// Indices must be less than vertexCount.
+size_t countVertexFetchBytes(const uint32_t *indices, size_t indexCount,
+    size_t vertexCount, size_t vertexByteSize);
+
+const uint32_t UNUSED_VERTEX = ~uint32_t(0);
+
+// Renumber vertices in the order the indices first use them, so that drawing
+// reads vertex memory mostly in order. remap receives the new index of each
+// of the vertexCount vertices, UNUSED_VERTEX for those not used. Returns the
+// number of vertices used.
+size_t optimizeVertexFetch(uint32_t *indices, size_t indexCount,
+    size_t vertexCount, uint32_t *remap);
+
+struct VertexFetchStatistics
+{
+  size_t vertexCount = 0;
+  // Vertices used by indices, the others are removed
+  size_t usedVertexCount = 0;
+  size_t usedByteCount = 0;
+  // Measured by countVertexFetchBytes()
+  size_t fetchedByteCountBefore = 0;
+  size_t fetchedByteCountAfter = 0;
+  // Accessors read by primitives with different vertex accessors, copied for
+  // each of them
+  size_t duplicatedAccessorCount = 0;
+};
+
+// Renumber the vertices of every indexed primitive by first use, in
+// parallel. Primitives reading the same vertex accessors, attributes and
+// morph targets, are renumbered together. An accessor also read along with
+// other ones is permuted separately for each set of accessors it is read
+// with. Permuted accessors and indices are stored in a new buffer, appended
+// to the model and to buffers, and primitives read them through new
+// accessors. Accessors that are sparse or cannot be read are left as they
+// are, with the primitives reading them.
+VertexFetchStatistics optimizeModelVertexFetch(
+    tinygltf::Model &model, GltfBuffers &buffers);
+
+// Size limits of meshlets, those of mesh shaders on most GPUs
+const size_t MESHLET_MAX_VERTEX_COUNT = 64;
+const size_t MESHLET_MAX_TRIANGLE_COUNT = 124;
+
+// Split the triangles, in their order, into meshlets of consecutive triangles
+// of at most MESHLET_MAX_VERTEX_COUNT vertices and MESHLET_MAX_TRIANGLE_COUNT
+// triangles, with their bounding sphere and normal cone. Triangles ordered by
+// optimizeVertexCache() give compact meshlets. positions holds 3 floats per
+// vertex, indices must be less than vertexCount.
+std::vector<Meshlet> buildMeshlets(const uint32_t *indices, size_t indexCount,
+    const float *positions, size_t vertexCount);
+
+struct MeshletStatistics
+{
+  size_t triangleCount = 0;
+  size_t meshletCount = 0;
+  // Sum of the vertices of each meshlet
+  size_t meshletVertexCount = 0;
+};
+
+// Split every indexed TRIANGLES primitive into meshlets, in parallel.
+// Meshlets are stored in a new buffer, appended to the model and to buffers,
+// and primitives read them through their MESHLET_*_ATTRIBUTE attributes.
+MeshletStatistics buildModelMeshlets(
+    tinygltf::Model &model, GltfBuffers &buffers);
+
+// Each level of detail has at most this ratio of the triangles of the
+// previous one, levels are built until the next would have less than
+// LOD_MIN_TRIANGLE_COUNT triangles or MAX_LOD_COUNT levels are built
+const float LOD_TRIANGLE_RATIO = 0.25f;
+const size_t LOD_MIN_TRIANGLE_COUNT = 64;
+// Largest error of a level of detail, relative to the size of its primitive
+const float LOD_MAX_RELATIVE_ERROR = 0.25f;
+
+// Collapse edges of the triangles, moving vertices onto one of their
+// neighbours, with the quadric error metric of Garland and Heckbert, until at
+// most targetIndexCount indices are left or collapses would move the surface
+// further than maxError, relative to the largest extent of the triangles. Only
+// indices change, the vertices are those of the input: vertices on borders
+// only move along them, and vertices sharing their position with others, on
+// attribute seams, do not move. Returns the new number of indices; error
+// receives an estimate of the distance between the input and output surfaces,
+// in the unit of positions. positions holds 3 floats per vertex, indices must
+// be less than vertexCount.
+size_t simplify(uint32_t *indices, size_t indexCount, const float *positions,
+    size_t vertexCount, size_t targetIndexCount, float maxError, float &error);
+
+struct LodStatistics
+{
+  size_t primitiveCount = 0; // With at least one level of detail
+  // Triangles of each level, the first one being the primitive itself
+  size_t levelTriangleCounts[MAX_LOD_COUNT + 1] = {};
+};
+
+// Build the levels of detail of every indexed TRIANGLES primitive, in
+// parallel, each one by simplifying the previous one and reordering it for
+// the vertex cache. Their indices and errors are stored in a new buffer,
+// appended to the model and to buffers, and primitives read them through their
+// LOD_*_ATTRIBUTE attributes.
+LodStatistics buildModelLods(tinygltf::Model &model, GltfBuffers &buffers);
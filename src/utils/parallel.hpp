@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Call task(i) for each i in [0, count) on all hardware threads, including the
+// calling one. Indices are handed out one by one so that tasks of uneven cost
+// (e.g. images of various sizes) keep every thread busy. task must not throw.
+template <typename Task> void parallelFor(size_t count, const Task &task)
+{
+  const auto threadCount = std::min<size_t>(
+      count, std::max(1u, std::thread::hardware_concurrency()));
+  if (threadCount <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> nextIdx{0};
+  const auto worker = [&]() {
+    for (auto i = nextIdx++; i < count; i = nextIdx++) {
+      task(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < threadCount; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
@@ -0,0 +1,540 @@
+#include "scene_cache.hpp"
+#include "gltf.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+
+// Bump CACHE_VERSION whenever the layout of the file changes, older files are
+// then ignored and rewritten
+const char CACHE_MAGIC[8] = {'G', 'L', 'T', 'F', 'V', 'C', 'C', 'H'};
+const uint32_t CACHE_VERSION = 2;
+const size_t CACHE_BLOB_ALIGNMENT = 16;
+
+// All records have a size multiple of 8 so that arrays stored one after the
+// other stay aligned in the memory mapped file
+struct CacheHeader
+{
+  char magic[8];
+  uint32_t version;
+  int32_t defaultScene;
+  uint64_t contentHash;
+  uint64_t sceneCount;
+  uint64_t nodeCount;
+  uint64_t meshCount;
+  uint64_t primitiveCount;
+  uint64_t attributeCount;
+  uint64_t accessorCount;
+  uint64_t bufferViewCount;
+  uint64_t bufferCount;
+};
+
+// Range of the nodes of a scene
+struct CacheScene
+{
+  uint32_t firstNode;
+  uint32_t nodeCount;
+};
+
+// Node of a scene with a mesh, with its world matrix
+struct CacheNode
+{
+  float worldMatrix[16];
+  int32_t mesh;
+  int32_t padding;
+};
+
+struct CacheMesh
+{
+  uint32_t firstPrimitive;
+  uint32_t primitiveCount;
+};
+
+struct CachePrimitive
+{
+  int32_t mode;
+  int32_t indices;
+  uint32_t firstAttribute;
+  uint32_t attributeCount;
+};
+
+struct CacheAttribute
+{
+  char name[56]; // Null terminated
+  int32_t accessor;
+  int32_t padding;
+};
+
+struct CacheAccessor
+{
+  uint64_t byteOffset;
+  uint64_t count;
+  int32_t bufferView;
+  int32_t componentType;
+  int32_t type;
+  int32_t normalized;
+};
+
+struct CacheBufferView
+{
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t byteStride;
+  int32_t buffer;
+  int32_t target;
+};
+
+struct CacheBuffer
+{
+  uint64_t fileOffset;
+  uint64_t size;
+};
+
+size_t alignUp(size_t offset, size_t alignment)
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+template <typename T>
+void writeArray(std::ostream &out, const std::vector<T> &values)
+{
+  out.write(reinterpret_cast<const char *>(values.data()),
+      std::streamsize(values.size() * sizeof(T)));
+}
+
+// Sequential reads of records in a memory mapped cache file, with bounds checks
+class CacheReader
+{
+  const unsigned char *m_pData;
+  size_t m_nSize;
+  size_t m_nOffset = 0;
+
+public:
+  CacheReader(const MappedFile &file) : m_pData(file.data()), m_nSize(file.size())
+  {
+  }
+
+  template <typename T> const T *read(uint64_t count)
+  {
+    if (count > (m_nSize - m_nOffset) / sizeof(T)) {
+      return nullptr;
+    }
+    const auto records = reinterpret_cast<const T *>(m_pData + m_nOffset);
+    m_nOffset += size_t(count) * sizeof(T);
+    return records;
+  }
+};
+
+// Nodes with a mesh of every scene, one range after the other
+void flattenScenes(const tinygltf::Model &model,
+    std::vector<CacheScene> &scenes, std::vector<CacheNode> &nodes)
+{
+  for (size_t sceneIdx = 0; sceneIdx < model.scenes.size(); ++sceneIdx) {
+    const auto scene = flattenScene(model, int(sceneIdx));
+    const auto firstNode = nodes.size();
+    for (size_t nodeEntry = 0; nodeEntry < scene.meshes.size(); ++nodeEntry) {
+      if (scene.meshes[nodeEntry] >= 0) {
+        CacheNode cacheNode{};
+        std::memcpy(cacheNode.worldMatrix,
+            glm::value_ptr(scene.worldMatrices[nodeEntry]),
+            sizeof(cacheNode.worldMatrix));
+        cacheNode.mesh = scene.meshes[nodeEntry];
+        nodes.emplace_back(cacheNode);
+      }
+    }
+    scenes.emplace_back(
+        CacheScene{uint32_t(firstNode), uint32_t(nodes.size() - firstNode)});
+  }
+}
+
+// Check indices between objects, so that a corrupted cache cannot make drawing
+// read out of bounds
+bool hasValidReferences(const tinygltf::Model &model)
+{
+  const auto isIndex = [](int idx, size_t count) {
+    return idx >= 0 && size_t(idx) < count;
+  };
+  for (const auto &node : model.nodes) {
+    if (!isIndex(node.mesh, model.meshes.size())) {
+      return false;
+    }
+  }
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      if (primitive.indices >= 0 &&
+          !isIndex(primitive.indices, model.accessors.size())) {
+        return false;
+      }
+      for (const auto &attribute : primitive.attributes) {
+        if (!isIndex(attribute.second, model.accessors.size())) {
+          return false;
+        }
+      }
+    }
+  }
+  for (const auto &accessor : model.accessors) {
+    if (accessor.bufferView >= 0 &&
+        !isIndex(accessor.bufferView, model.bufferViews.size())) {
+      return false;
+    }
+  }
+  for (const auto &bufferView : model.bufferViews) {
+    if (!isIndex(bufferView.buffer, model.buffers.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+bool computeGltfContentHash(
+    const fs::path &path, uint64_t &contentHash, std::string &err)
+{
+  std::vector<std::string> files;
+  if (!listGltfFiles(path, files, err)) {
+    return false;
+  }
+
+  std::vector<uint64_t> fileHashes(files.size(), 0);
+  std::vector<std::string> errors(files.size());
+  parallelFor(files.size(), [&](size_t i) {
+    try {
+      const MappedFile file(files[i]);
+      fileHashes[i] = hash64(file.data(), file.size());
+    } catch (const std::runtime_error &e) {
+      errors[i] = std::string(e.what()) + "\n";
+    }
+  });
+  for (const auto &error : errors) {
+    if (!error.empty()) {
+      err += error;
+      return false;
+    }
+  }
+
+  contentHash =
+      hash64(fileHashes.data(), fileHashes.size() * sizeof(uint64_t));
+  return true;
+}
+
+fs::path getSceneCachePath(const fs::path &cacheDirectory, uint64_t contentHash)
+{
+  std::stringstream ss;
+  ss << std::hex << std::setw(16) << std::setfill('0') << contentHash
+     << ".scenecache";
+  return cacheDirectory / ss.str();
+}
+
+bool writeSceneCache(const fs::path &cachePath, uint64_t contentHash,
+    const tinygltf::Model &model, const GltfBuffers &buffers, std::string &err)
+{
+  std::vector<CacheScene> scenes;
+  std::vector<CacheNode> nodes;
+  flattenScenes(model, scenes, nodes);
+
+  // Only the bufferViews read by meshes are stored, packed one after the
+  // other in a single buffer. Images, animations and data orphaned by import
+  // stages are left out.
+  std::vector<int> cacheBufferViewIndices(model.bufferViews.size(), -1);
+  std::vector<CacheBufferView> bufferViews;
+  std::vector<BufferBytes> bufferViewBytes; // Parallel to bufferViews
+  size_t blobSize = 0;
+  for (const auto bufferViewIdx : computeMeshBufferViews(model)) {
+    const auto &bufferView = model.bufferViews[bufferViewIdx];
+    if (bufferView.buffer < 0 ||
+        size_t(bufferView.buffer) >= buffers.bytes.size() ||
+        bufferView.byteOffset + bufferView.byteLength >
+            buffers.bytes[bufferView.buffer].size) {
+      err += "Invalid bufferView " + std::to_string(bufferViewIdx) +
+             " for scene cache\n";
+      return false;
+    }
+    blobSize = alignUp(blobSize, CACHE_BLOB_ALIGNMENT);
+    cacheBufferViewIndices[bufferViewIdx] = int(bufferViews.size());
+    bufferViews.emplace_back(CacheBufferView{blobSize, bufferView.byteLength,
+        bufferView.byteStride, 0, bufferView.target});
+    bufferViewBytes.emplace_back(
+        BufferBytes{buffers.bytes[bufferView.buffer].data +
+                        bufferView.byteOffset,
+            bufferView.byteLength});
+    blobSize += bufferView.byteLength;
+  }
+
+  // Accessors read by meshes, renumbered in the order meshes read them
+  std::vector<int> cacheAccessorIndices(model.accessors.size(), -1);
+  std::vector<CacheAccessor> accessors;
+  const auto addAccessor = [&](int accessorIdx, int &cacheAccessorIdx) {
+    if (accessorIdx < 0 || size_t(accessorIdx) >= model.accessors.size()) {
+      err += "Invalid accessor " + std::to_string(accessorIdx) +
+             " for scene cache\n";
+      return false;
+    }
+    if (cacheAccessorIndices[accessorIdx] < 0) {
+      const auto &accessor = model.accessors[accessorIdx];
+      if (accessor.bufferView >= int(model.bufferViews.size())) {
+        err += "Invalid bufferView " + std::to_string(accessor.bufferView) +
+               " for scene cache\n";
+        return false;
+      }
+      // Their values are not in the bufferView alone
+      if (accessor.sparse.isSparse) {
+        err += "Sparse accessors are not supported by the scene cache\n";
+        return false;
+      }
+      cacheAccessorIndices[accessorIdx] = int(accessors.size());
+      accessors.emplace_back(CacheAccessor{accessor.byteOffset, accessor.count,
+          accessor.bufferView >= 0
+              ? cacheBufferViewIndices[accessor.bufferView]
+              : -1,
+          accessor.componentType, accessor.type, accessor.normalized});
+    }
+    cacheAccessorIdx = cacheAccessorIndices[accessorIdx];
+    return true;
+  };
+
+  std::vector<CacheMesh> meshes;
+  std::vector<CachePrimitive> primitives;
+  std::vector<CacheAttribute> attributes;
+  for (const auto &mesh : model.meshes) {
+    meshes.emplace_back(CacheMesh{
+        uint32_t(primitives.size()), uint32_t(mesh.primitives.size())});
+    for (const auto &primitive : mesh.primitives) {
+      CachePrimitive cachePrimitive{primitive.mode, -1,
+          uint32_t(attributes.size()), uint32_t(primitive.attributes.size())};
+      if (primitive.indices >= 0 &&
+          !addAccessor(primitive.indices, cachePrimitive.indices)) {
+        return false;
+      }
+      primitives.emplace_back(cachePrimitive);
+      for (const auto &attribute : primitive.attributes) {
+        CacheAttribute cacheAttribute{};
+        if (attribute.first.size() >= sizeof(cacheAttribute.name)) {
+          err += "Attribute name too long for scene cache: " +
+                 attribute.first + "\n";
+          return false;
+        }
+        std::strcpy(cacheAttribute.name, attribute.first.c_str());
+        if (!addAccessor(attribute.second, cacheAttribute.accessor)) {
+          return false;
+        }
+        attributes.emplace_back(cacheAttribute);
+      }
+    }
+  }
+
+  CacheHeader header{};
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  header.version = CACHE_VERSION;
+  header.defaultScene = model.defaultScene;
+  header.contentHash = contentHash;
+  header.sceneCount = scenes.size();
+  header.nodeCount = nodes.size();
+  header.meshCount = meshes.size();
+  header.primitiveCount = primitives.size();
+  header.attributeCount = attributes.size();
+  header.accessorCount = accessors.size();
+  header.bufferViewCount = bufferViews.size();
+  header.bufferCount = 1;
+
+  const auto fileOffset = alignUp(
+      sizeof(CacheHeader) + scenes.size() * sizeof(CacheScene) +
+          nodes.size() * sizeof(CacheNode) +
+          meshes.size() * sizeof(CacheMesh) +
+          primitives.size() * sizeof(CachePrimitive) +
+          attributes.size() * sizeof(CacheAttribute) +
+          accessors.size() * sizeof(CacheAccessor) +
+          bufferViews.size() * sizeof(CacheBufferView) + sizeof(CacheBuffer),
+      CACHE_BLOB_ALIGNMENT);
+  const std::vector<CacheBuffer> cacheBuffers = {
+      CacheBuffer{fileOffset, blobSize}};
+
+  // Write to a temporary file then rename it, so that concurrent viewers
+  // never see a partially written cache
+  auto tmpPath = cachePath;
+  tmpPath += ".tmp" + std::to_string(std::chrono::steady_clock::now()
+                                         .time_since_epoch()
+                                         .count());
+  try {
+    fs::create_directories(cachePath.parent_path());
+    {
+      std::ofstream out(tmpPath.string(), std::ios::binary);
+      if (!out) {
+        err += "Unable to open file " + tmpPath.string() + "\n";
+        return false;
+      }
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      writeArray(out, scenes);
+      writeArray(out, nodes);
+      writeArray(out, meshes);
+      writeArray(out, primitives);
+      writeArray(out, attributes);
+      writeArray(out, accessors);
+      writeArray(out, bufferViews);
+      writeArray(out, cacheBuffers);
+      for (size_t i = 0; i < bufferViews.size(); ++i) {
+        const char padding[CACHE_BLOB_ALIGNMENT] = {};
+        out.write(padding,
+            std::streamsize(fileOffset + bufferViews[i].byteOffset -
+                            size_t(out.tellp())));
+        out.write(reinterpret_cast<const char *>(bufferViewBytes[i].data),
+            std::streamsize(bufferViewBytes[i].size));
+      }
+      if (!out) {
+        err += "Unable to write file " + tmpPath.string() + "\n";
+        out.close();
+        fs::remove(tmpPath);
+        return false;
+      }
+    }
+    fs::rename(tmpPath, cachePath);
+  } catch (const std::exception &e) {
+    err += std::string(e.what()) + "\n";
+    return false;
+  }
+  return true;
+}
+
+bool loadSceneCache(const fs::path &cachePath, uint64_t contentHash,
+    tinygltf::Model &model, GltfBuffers &buffers, std::string &err)
+{
+  MappedFile file;
+  try {
+    file = MappedFile(cachePath);
+  } catch (const std::runtime_error &e) {
+    err += std::string(e.what()) + "\n";
+    return false;
+  }
+
+  CacheReader reader(file);
+  const auto header = reader.read<CacheHeader>(1);
+  if (!header ||
+      std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      header->version != CACHE_VERSION ||
+      header->contentHash != contentHash) {
+    err += "Invalid or outdated scene cache " + cachePath.string() + "\n";
+    return false;
+  }
+  const auto scenes = reader.read<CacheScene>(header->sceneCount);
+  const auto nodes = reader.read<CacheNode>(header->nodeCount);
+  const auto meshes = reader.read<CacheMesh>(header->meshCount);
+  const auto primitives = reader.read<CachePrimitive>(header->primitiveCount);
+  const auto attributes = reader.read<CacheAttribute>(header->attributeCount);
+  const auto accessors = reader.read<CacheAccessor>(header->accessorCount);
+  const auto bufferViews =
+      reader.read<CacheBufferView>(header->bufferViewCount);
+  const auto cacheBuffers = reader.read<CacheBuffer>(header->bufferCount);
+  if (!scenes || !nodes || !meshes || !primitives || !attributes ||
+      !accessors || !bufferViews || !cacheBuffers) {
+    err += "Truncated scene cache " + cachePath.string() + "\n";
+    return false;
+  }
+
+  model = tinygltf::Model{};
+  buffers = GltfBuffers{};
+  model.buffers.resize(header->bufferCount);
+  buffers.bytes.resize(header->bufferCount);
+  for (size_t i = 0; i < header->bufferCount; ++i) {
+    const auto &cacheBuffer = cacheBuffers[i];
+    if (cacheBuffer.fileOffset > file.size() ||
+        cacheBuffer.size > file.size() - cacheBuffer.fileOffset) {
+      err += "Truncated scene cache " + cachePath.string() + "\n";
+      return false;
+    }
+    buffers.bytes[i] =
+        BufferBytes{file.data() + cacheBuffer.fileOffset, cacheBuffer.size};
+  }
+
+  for (size_t i = 0; i < header->bufferViewCount; ++i) {
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferViews[i].buffer;
+    bufferView.byteOffset = bufferViews[i].byteOffset;
+    bufferView.byteLength = bufferViews[i].byteLength;
+    bufferView.byteStride = bufferViews[i].byteStride;
+    bufferView.target = bufferViews[i].target;
+    model.bufferViews.emplace_back(std::move(bufferView));
+  }
+
+  for (size_t i = 0; i < header->accessorCount; ++i) {
+    tinygltf::Accessor accessor;
+    accessor.bufferView = accessors[i].bufferView;
+    accessor.byteOffset = accessors[i].byteOffset;
+    accessor.count = accessors[i].count;
+    accessor.componentType = accessors[i].componentType;
+    accessor.type = accessors[i].type;
+    accessor.normalized = accessors[i].normalized != 0;
+    model.accessors.emplace_back(std::move(accessor));
+  }
+
+  for (size_t i = 0; i < header->meshCount; ++i) {
+    tinygltf::Mesh mesh;
+    if (uint64_t(meshes[i].firstPrimitive) + meshes[i].primitiveCount >
+        header->primitiveCount) {
+      err += "Invalid scene cache " + cachePath.string() + "\n";
+      return false;
+    }
+    for (size_t p = 0; p < meshes[i].primitiveCount; ++p) {
+      const auto &cachePrimitive = primitives[meshes[i].firstPrimitive + p];
+      if (uint64_t(cachePrimitive.firstAttribute) +
+              cachePrimitive.attributeCount >
+          header->attributeCount) {
+        err += "Invalid scene cache " + cachePath.string() + "\n";
+        return false;
+      }
+      tinygltf::Primitive primitive;
+      primitive.mode = cachePrimitive.mode;
+      primitive.indices = cachePrimitive.indices;
+      for (size_t a = 0; a < cachePrimitive.attributeCount; ++a) {
+        const auto &attribute = attributes[cachePrimitive.firstAttribute + a];
+        primitive.attributes[std::string(attribute.name,
+            strnlen(attribute.name, sizeof(attribute.name)))] =
+            attribute.accessor;
+      }
+      mesh.primitives.emplace_back(std::move(primitive));
+    }
+    model.meshes.emplace_back(std::move(mesh));
+  }
+
+  for (size_t i = 0; i < header->nodeCount; ++i) {
+    tinygltf::Node node;
+    node.mesh = nodes[i].mesh;
+    node.matrix.assign(nodes[i].worldMatrix, nodes[i].worldMatrix + 16);
+    model.nodes.emplace_back(std::move(node));
+  }
+  for (size_t i = 0; i < header->sceneCount; ++i) {
+    if (uint64_t(scenes[i].firstNode) + scenes[i].nodeCount >
+        header->nodeCount) {
+      err += "Invalid scene cache " + cachePath.string() + "\n";
+      return false;
+    }
+    tinygltf::Scene scene;
+    for (size_t n = 0; n < scenes[i].nodeCount; ++n) {
+      scene.nodes.emplace_back(int(scenes[i].firstNode + n));
+    }
+    model.scenes.emplace_back(std::move(scene));
+  }
+  model.defaultScene = header->defaultScene;
+  if (model.defaultScene < -1 ||
+      model.defaultScene >= int(header->sceneCount)) {
+    err += "Invalid scene cache " + cachePath.string() + "\n";
+    return false;
+  }
+
+  if (!hasValidReferences(model)) {
+    err += "Invalid scene cache " + cachePath.string() + "\n";
+    return false;
+  }
+
+  buffers.mappedFiles.emplace_back(std::move(file));
+  return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gltf_loader.hpp"
+
+#include <cstdint>
+#include <string>
+#include <tiny_gltf.h>
+
+// On-disk cache of a loaded glTF scene, ready to be uploaded to the GPU. It
+// stores the nodes of every scene flattened to their world matrices, the
+// meshes, primitives, accessors and bufferViews needed to draw them, and the
+// bytes of these bufferViews only. Loading a cache file does not involve
+// tinygltf: the file is memory mapped and buffers are viewed in place.
+
+// Hash of the content of a glTF file and of every external file it reads
+bool computeGltfContentHash(
+    const fs::path &path, uint64_t &contentHash, std::string &err);
+
+fs::path getSceneCachePath(const fs::path &cacheDirectory, uint64_t contentHash);
+
+bool writeSceneCache(const fs::path &cachePath, uint64_t contentHash,
+    const tinygltf::Model &model, const GltfBuffers &buffers, std::string &err);
+
+// Fill model with only what drawing needs and buffers with views in the cache
+// file. Fails if the file is missing, invalid, or has another content hash.
+bool loadSceneCache(const fs::path &cachePath, uint64_t contentHash,
+    tinygltf::Model &model, GltfBuffers &buffers, std::string &err);
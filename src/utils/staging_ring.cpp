@@ -0,0 +1,84 @@
+#include "staging_ring.hpp"
+
+// Offsets in the ring are aligned so that any scalar can be written there
+static const size_t STAGING_RING_ALIGNMENT = 16;
+
+StagingRing::StagingRing(size_t capacity) :
+    m_nCapacity((capacity + STAGING_RING_ALIGNMENT - 1) /
+                STAGING_RING_ALIGNMENT * STAGING_RING_ALIGNMENT)
+{
+  if (m_nCapacity == 0) {
+    return; // Zero sized storage is an error for OpenGL
+  }
+  const auto flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  m_buffer = createBuffer(m_nCapacity, flags);
+  glBindBuffer(GL_COPY_READ_BUFFER, m_buffer.glId());
+  // Coherent: writes are visible to the copies issued after them without any
+  // flush or barrier
+  m_pMapping = static_cast<unsigned char *>(glMapBufferRange(
+      GL_COPY_READ_BUFFER, 0, GLsizeiptr(m_nCapacity), flags));
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+unsigned char *StagingRing::allocate(size_t size, size_t &offset)
+{
+  if (!m_pMapping || size > m_nCapacity) {
+    return nullptr;
+  }
+  recycle();
+  if (m_nRecycledByteCount == m_nAllocatedByteCount) {
+    // Nothing is in use, start again from the beginning of the ring
+    m_nAllocatedByteCount = 0;
+    m_nRecycledByteCount = 0;
+    m_nFencedByteCount = 0;
+  }
+  auto position = (m_nAllocatedByteCount + STAGING_RING_ALIGNMENT - 1) /
+                  STAGING_RING_ALIGNMENT * STAGING_RING_ALIGNMENT;
+  offset = position % m_nCapacity;
+  if (offset + size > m_nCapacity) {
+    // Allocations are contiguous, skip the end of the ring
+    position += m_nCapacity - offset;
+    offset = 0;
+  }
+  if (position + size - m_nRecycledByteCount > m_nCapacity) {
+    return nullptr;
+  }
+  m_nAllocatedByteCount = position + size;
+  return m_pMapping + offset;
+}
+
+void StagingRing::copy(
+    size_t offset, GLuint bufferObject, size_t byteOffset, size_t size) const
+{
+  glBindBuffer(GL_COPY_READ_BUFFER, m_buffer.glId());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, bufferObject);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+      GLintptr(offset), GLintptr(byteOffset), GLsizeiptr(size));
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StagingRing::fence()
+{
+  if (m_nFencedByteCount == m_nAllocatedByteCount) {
+    return;
+  }
+  m_fences.emplace_back(
+      Fence{GLSync(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)),
+          m_nAllocatedByteCount});
+  m_nFencedByteCount = m_nAllocatedByteCount;
+}
+
+void StagingRing::recycle()
+{
+  // Fences are signaled in order, stop at the first one still pending
+  while (!m_fences.empty()) {
+    const auto status = glClientWaitSync(m_fences.front().sync.get(), 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    m_nRecycledByteCount = m_fences.front().allocatedByteCount;
+    m_fences.pop_front();
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "gl_objects.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <glad/glad.h>
+
+// Persistently mapped and coherent buffer object through which data is copied
+// to other buffer objects. Its memory is handed out in ring order, and recycled
+// once fences signal that the GPU executed the copies reading it, so that
+// uploads overlap rendering instead of waiting for it.
+class StagingRing
+{
+  struct Fence
+  {
+    GLSync sync;
+    size_t allocatedByteCount; // Bytes recycled once sync is signaled
+  };
+
+  GLBuffer m_buffer; // Deleting it unmaps it
+  unsigned char *m_pMapping = nullptr;
+  size_t m_nCapacity = 0;
+  // Bytes handed out and recycled since creation, their offset in the buffer
+  // is taken modulo m_nCapacity
+  size_t m_nAllocatedByteCount = 0;
+  size_t m_nRecycledByteCount = 0;
+  size_t m_nFencedByteCount = 0;
+  std::deque<Fence> m_fences;
+
+public:
+  StagingRing() = default;
+
+  // Requires a GL 4.4 context for glBufferStorage
+  explicit StagingRing(size_t capacity);
+
+  size_t capacity() const { return m_nCapacity; }
+
+  // Memory to write size bytes to, at offset in the ring, aligned for any
+  // scalar type. Return null if not enough memory is recycled yet. size must
+  // be at most capacity().
+  unsigned char *allocate(size_t size, size_t &offset);
+
+  // Copy bytes written at offset in the ring to another buffer object
+  void copy(size_t offset, GLuint bufferObject, size_t byteOffset,
+      size_t size) const;
+
+  // Fence the copies issued so far, the memory they read is recycled once the
+  // GPU executed them. Called once per frame.
+  void fence();
+
+private:
+  void recycle();
+};